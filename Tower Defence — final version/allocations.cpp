@@ -0,0 +1,90 @@
+#include "allocations.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::atomic<std::uint64_t> s_allocations = 0;
+	std::atomic<std::uint64_t> s_bytes = 0;
+}
+
+std::uint64_t countAllocations()
+{
+	return s_allocations.load(std::memory_order_relaxed);
+}
+
+std::uint64_t countAllocatedBytes()
+{
+	return s_bytes.load(std::memory_order_relaxed);
+}
+
+std::uint64_t residentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	// the second field is the resident size in pages
+	std::ifstream statm("/proc/self/statm");
+	std::uint64_t size = 0, resident = 0;
+	if (statm >> size >> resident)
+		return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+	return 0;
+#endif
+}
+
+// the other forms of new and delete fall back on these
+void* operator new(std::size_t size)
+{
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	s_bytes.fetch_add(size, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	while (true)
+	{
+		if (void* memory = std::malloc(size))
+			return memory;
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
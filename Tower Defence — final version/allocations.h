@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+// Heap allocations of the whole process, counted by the global operator new, which is
+// replaced for that in allocations.cpp. Counting costs two relaxed atomic additions per
+// allocation. The counts only grow; a frame's share is the difference between two reads.
+
+std::uint64_t countAllocations();
+std::uint64_t countAllocatedBytes();
+std::uint64_t residentBytes(); // of the process, as the system counts them; 0 where it cannot tell
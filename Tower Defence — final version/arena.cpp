@@ -0,0 +1,34 @@
+#include "arena.h"
+
+Arena::Arena(std::size_t capacity)
+{
+	m_buffer = std::make_unique<std::byte[]>(capacity);
+	m_capacity = capacity;
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	std::size_t offset = (m_used + alignment - 1) & ~(alignment - 1);
+	if (offset + size <= m_capacity)
+	{
+		m_used = offset + size;
+		return m_buffer.get() + offset;
+	}
+	std::size_t space = size + alignment;
+	m_spill.emplace_back(std::make_unique<std::byte[]>(space));
+	m_spilled += space;
+	void* pointer = m_spill.back().get();
+	return std::align(alignment, size, pointer, space);
+}
+
+void Arena::reset()
+{
+	if (m_spilled > 0)
+	{
+		m_capacity = 2 * (m_capacity + m_spilled);
+		m_buffer = std::make_unique<std::byte[]>(m_capacity);
+		m_spill.clear();
+		m_spilled = 0;
+	}
+	m_used = 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for per-tick temporaries. Everything is released at once by reset();
+// an overflowing tick spills into extra blocks, which are folded into the main buffer
+// on the next reset, so a warmed-up arena does not touch the heap any more.
+
+const std::size_t ARENA_CAPACITY = 1 << 16;
+
+class Arena
+{
+private:
+
+	std::unique_ptr<std::byte[]> m_buffer;
+	std::size_t m_capacity = 0;
+	std::size_t m_used = 0;
+	std::vector<std::unique_ptr<std::byte[]>> m_spill;
+	std::size_t m_spilled = 0;
+
+	void* allocate(std::size_t size, std::size_t alignment);
+
+public:
+
+	Arena(std::size_t capacity = ARENA_CAPACITY);
+
+	template <typename T>
+	T* make(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+		T* first = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+		std::uninitialized_value_construct_n(first, count);
+		return first;
+	}
+
+	void reset();
+};
@@ -0,0 +1,41 @@
+#include "arguments.h"
+#include "error.h"
+#include <charconv>
+#include <limits>
+
+namespace
+{
+	template <typename T>
+	T parse(const std::string& text)
+	{
+		T value{};
+		const char* last = text.data() + text.size();
+		auto [end, error] = std::from_chars(text.data(), last, value);
+		if (text.empty() or error != std::errc() or end != last)
+			throw Error(Problem::BadArgument);
+		return value;
+	}
+}
+
+int parseInt(const std::string& text)
+{
+	return parse<int>(text);
+}
+
+std::uint64_t parseUnsigned(const std::string& text)
+{
+	return parse<std::uint64_t>(text);
+}
+
+double parseDouble(const std::string& text)
+{
+	return parse<double>(text);
+}
+
+unsigned short parsePort(const std::string& text)
+{
+	int port = parse<int>(text);
+	if (port < 0 or port > std::numeric_limits<unsigned short>::max())
+		throw Error(Problem::BadArgument);
+	return static_cast<unsigned short>(port);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Numbers given on the command line. The whole text has to be the number, or
+// Error(Problem::BadArgument) is thrown, which the tools and the game report like
+// any other error instead of ending on an exception nobody catches.
+
+int parseInt(const std::string& text);
+std::uint64_t parseUnsigned(const std::string& text);
+double parseDouble(const std::string& text);
+unsigned short parsePort(const std::string& text);
@@ -0,0 +1,205 @@
+#include "binary.h"
+#include "error.h"
+#include <fstream>
+#include <iterator>
+
+void ByteWriter::writeByte(std::uint8_t value)
+{
+	m_bytes.push_back(value);
+}
+
+void ByteWriter::writeVarint(std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		m_bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	m_bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+void ByteWriter::writeSigned(std::int64_t value)
+{
+	writeVarint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+void ByteWriter::writeWord(std::uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		m_bytes.push_back(static_cast<std::uint8_t>(value >> 8 * i));
+}
+
+void ByteWriter::writeString(const std::string& value)
+{
+	writeVarint(value.size());
+	m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+}
+
+void ByteWriter::writeBytes(const std::uint8_t* data, std::size_t size)
+{
+	m_bytes.insert(m_bytes.end(), data, data + size);
+}
+
+std::size_t ByteWriter::getSize() const
+{
+	return m_bytes.size();
+}
+
+const std::vector<std::uint8_t>& ByteWriter::getBytes() const
+{
+	return m_bytes;
+}
+
+void ByteWriter::clear()
+{
+	m_bytes.clear();
+}
+
+void ByteReader::require(std::size_t size) const
+{
+	if (size > m_size - m_position)
+		throw Error(Problem::FileError);
+}
+
+ByteReader::ByteReader(const std::uint8_t* data, std::size_t size) :
+	m_data(data),
+	m_size(size)
+{
+}
+
+ByteReader::ByteReader(const std::vector<std::uint8_t>& bytes) :
+	ByteReader(bytes.data(), bytes.size())
+{
+}
+
+std::uint8_t ByteReader::readByte()
+{
+	require(1);
+	return m_data[m_position++];
+}
+
+std::uint64_t ByteReader::readVarint()
+{
+	std::uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		std::uint8_t byte = readByte();
+		value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+		if (not (byte & 0x80))
+			return value;
+	}
+	throw Error(Problem::FileError);
+}
+
+std::uint64_t ByteReader::readCount()
+{
+	std::uint64_t count = readVarint();
+	require(count);
+	return count;
+}
+
+std::int64_t ByteReader::readSigned()
+{
+	std::uint64_t value = readVarint();
+	return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::uint64_t ByteReader::readWord()
+{
+	require(8);
+	std::uint64_t value = 0;
+	for (int i = 0; i < 8; ++i)
+		value |= static_cast<std::uint64_t>(m_data[m_position + i]) << 8 * i;
+	m_position += 8;
+	return value;
+}
+
+std::string ByteReader::readString()
+{
+	std::uint64_t size = readVarint();
+	const std::uint8_t* data = readBytes(size);
+	return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+const std::uint8_t* ByteReader::readBytes(std::size_t size)
+{
+	require(size);
+	const std::uint8_t* data = m_data + m_position;
+	m_position += size;
+	return data;
+}
+
+std::size_t ByteReader::getPosition() const
+{
+	return m_position;
+}
+
+void ByteReader::seek(std::size_t position)
+{
+	if (position > m_size)
+		throw Error(Problem::FileError);
+	m_position = position;
+}
+
+bool ByteReader::atEnd() const
+{
+	return m_position == m_size;
+}
+
+void readFile(const std::filesystem::path& path, std::vector<std::uint8_t>& bytes)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (not file.is_open())
+		throw Error(Problem::FileError);
+	bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (file.bad())
+		throw Error(Problem::FileError);
+}
+
+void writeFile(const std::filesystem::path& path, const std::vector<std::uint8_t>& bytes)
+{
+	// written aside and renamed, so a crash never leaves half a file under the name
+	std::filesystem::path temporary = path;
+	temporary += ".part";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (not file.is_open())
+			throw Error(Problem::FileError);
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		if (not file.good())
+			throw Error(Problem::FileError);
+	}
+	std::error_code code;
+	std::filesystem::rename(temporary, path, code);
+	if (code)
+		throw Error(Problem::FileError);
+}
+
+std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t hash)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+std::uint64_t hashFile(const std::filesystem::path& path)
+{
+	if (not std::filesystem::exists(path))
+		return 0;
+	std::vector<std::uint8_t> bytes;
+	readFile(path, bytes);
+	return hashBytes(bytes.data(), bytes.size());
+}
+
+std::uint64_t hashValue(std::uint64_t hash, std::uint64_t value)
+{
+	// one round of a 64-bit mixer, cheap enough for hashing every tick
+	hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 31;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	return hash ^ (hash >> 27);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Little-endian binary encoding for replays, saves and streams. Counts and small numbers
+// are written as variable-length integers (7 bits a byte), signed ones zigzag-encoded,
+// so that typical values take one or two bytes. A reader running past the end of its
+// bytes throws Error(Problem::FileError).
+
+const std::uint64_t HASH_BASIS = 0xcbf29ce484222325ULL; // FNV-1a offset basis
+
+class ByteWriter
+{
+private:
+
+	std::vector<std::uint8_t> m_bytes;
+
+public:
+
+	void writeByte(std::uint8_t value);
+	void writeVarint(std::uint64_t value);
+	void writeSigned(std::int64_t value);
+	void writeWord(std::uint64_t value); // always 8 bytes, for hashes and states
+	void writeString(const std::string& value);
+	void writeBytes(const std::uint8_t* data, std::size_t size);
+
+	std::size_t getSize() const;
+	const std::vector<std::uint8_t>& getBytes() const;
+	void clear();
+};
+
+class ByteReader
+{
+private:
+
+	const std::uint8_t* m_data;
+	std::size_t m_size;
+	std::size_t m_position = 0;
+
+	void require(std::size_t size) const;
+
+public:
+
+	ByteReader(const std::uint8_t* data, std::size_t size);
+	ByteReader(const std::vector<std::uint8_t>& bytes);
+
+	std::uint8_t readByte();
+	std::uint64_t readVarint();
+	std::uint64_t readCount(); // of items taking a byte at least, checked against what is left
+	std::int64_t readSigned();
+	std::uint64_t readWord();
+	std::string readString();
+	const std::uint8_t* readBytes(std::size_t size); // points into the reader's data
+
+	std::size_t getPosition() const;
+	void seek(std::size_t position);
+	bool atEnd() const;
+};
+
+void readFile(const std::filesystem::path& path, std::vector<std::uint8_t>& bytes);
+void writeFile(const std::filesystem::path& path, const std::vector<std::uint8_t>& bytes);
+
+std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t hash = HASH_BASIS);
+std::uint64_t hashFile(const std::filesystem::path& path); // 0 for a missing file
+std::uint64_t hashValue(std::uint64_t hash, std::uint64_t value); // folds one value into a running hash
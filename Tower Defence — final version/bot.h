@@ -0,0 +1,88 @@
+#pragma once
+
+// Interface of placement bots, which are built apart from the game as shared objects
+// (.dll, .so) and loaded by the tournament. Only plain structures and C functions cross
+// the boundary, so a bot does not have to share the game's compiler or standard library.
+// A bot exports the three functions below; BOT_VERSION changes whenever they or the
+// structures do, and bots reporting another version are not loaded.
+//
+//	BOT_EXPORT int botVersion() { return BOT_VERSION; }
+//	BOT_EXPORT const char* botName() { return "Greedy"; }
+//	BOT_EXPORT int botPlace(const BotGame* game, BotPlacement* placements, int capacity);
+//
+// botPlace gets everything known before the first wave and writes at most capacity
+// placements, returning their number. Placements are bought in order while the money
+// lasts; invalid ones are skipped. The function must not throw; it may be called from
+// any thread, but never twice at once.
+
+const int BOT_VERSION = 1;
+
+enum BotPointKind { BOT_SOURCE, BOT_VERTEX, BOT_TOWER };
+
+struct BotPoint
+{
+	float x, y; // pixels
+	int kind;
+};
+
+struct BotEdge
+{
+	int tail, head; // indices of the points; entities walk from the tail to the head
+};
+
+struct BotDefence // indexed by the defence type: uni-shooter, multi-shooter, cannon, freezer
+{
+	int cost;
+	float radius;
+	int period; // attack rounds between shots
+	int force; // damage, or frozen ticks for the freezer
+	int hits; // targets per shot
+};
+
+struct BotEntity // indexed by the entity type
+{
+	float speed;
+	int health;
+	int force; // health taken from the player on arrival
+	int prize;
+};
+
+struct BotGroup
+{
+	int entity;
+	int count;
+};
+
+struct BotGame
+{
+	float width, height;
+	const BotPoint* points;
+	int points_number;
+	const BotEdge* edges;
+	int edges_number;
+	const BotDefence* defences;
+	int defences_number;
+	const BotEntity* entities;
+	int entities_number;
+	const BotGroup* groups; // all waves, one after another
+	int groups_number;
+	const int* wave_ends; // the groups of wave w end before wave_ends[w]
+	int waves_number;
+	int money;
+};
+
+struct BotPlacement
+{
+	int type;
+	int x, y;
+};
+
+using BotVersionFunction = int (*)();
+using BotNameFunction = const char* (*)();
+using BotPlaceFunction = int (*)(const BotGame* game, BotPlacement* placements, int capacity);
+
+#if defined(_WIN32)
+#define BOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define BOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
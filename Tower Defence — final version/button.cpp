@@ -35,10 +35,11 @@ void Button::setOutlineThickness(float thickness)
 	m_text.move(-thickness, -thickness);
 }
 
-void Button::drawYourself(sf::RenderWindow& window)
+int Button::drawYourself(sf::RenderWindow& window)
 {
 	window.draw(m_background);
 	window.draw(m_text);
+	return 2;
 }
 
 bool Button::contains(const sf::Vector2f& coords)
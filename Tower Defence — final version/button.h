@@ -18,7 +18,7 @@ struct Button
 	void setColors(const sf::Color& color_1, const sf::Color& color_2);
 	void setOutlineThickness(float thickness);
 
-	void drawYourself(sf::RenderWindow& window);
+	int drawYourself(sf::RenderWindow& window); // returns the number of draw calls
 	bool contains(const sf::Vector2f& coords);
 
 	void toggle();
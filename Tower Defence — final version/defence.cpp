@@ -1,19 +1,31 @@
 #include "defence.h"
 #include "error.h"
 #include "manager.h"
+#include "profile.h"
 #include <cmath>
 
 #include <iostream>
 
+void Defence::setType(DefenceType type)
+{
+	m_type = type;
+}
+
 void Defence::setRadius(float radius)
 {
-	m_radius = radius;
+	m_radius = toFixed(radius);
 }
 
 void Defence::setPeriod(int period)
 {
 	m_period = period;
-	m_counter = std::rand() % period;
+	m_counter = 0;
+}
+
+void Defence::stagger(Random& random)
+{
+	// defences bought together should not all fire on the same tick
+	m_counter = random.below(m_period);
 }
 
 void Defence::setForce(int force)
@@ -31,40 +43,62 @@ void Defence::setCost(int cost)
 	m_cost = cost;
 }
 
-void Defence::setTexture(const sf::Texture& texture)
+void Defence::setPosition(const sf::Vector2f& coords)
 {
-	m_sprite.setTexture(texture);
+	m_position = toFixed(coords);
 }
 
-void Defence::setPosition(const sf::Vector2f& coords)
+DefenceType Defence::getType() const
 {
-	m_position = coords;
-	m_sprite.setPosition(coords + m_shift);
+	return m_type;
 }
 
-void Defence::setScale(float scale)
+int Defence::getCost() const
 {
-	m_sprite.setScale(scale, scale);
+	return m_cost;
 }
 
-void Defence::setShift(const sf::Vector2f& offset)
+float Defence::getRadius() const
 {
-	m_shift = offset;
+	return toFloat(m_radius);
 }
 
-int Defence::getCost()
+FixedVector Defence::getPosition() const
 {
-	return m_cost;
+	return m_position;
+}
+
+int Defence::getCounter() const
+{
+	return m_counter;
 }
 
-float Defence::getRadius()
+int Defence::getHitsDone() const
 {
-	return m_radius;
+	return m_hits_done;
 }
 
-void Defence::drawYourself(sf::RenderWindow& window)
+int Defence::getRangeTests() const
 {
-	window.draw(m_sprite);
+	return m_range_tests;
+}
+
+void Defence::write(ByteWriter& writer) const
+{
+	writer.writeSigned(m_position.x);
+	writer.writeSigned(m_position.y);
+	writer.writeVarint(m_counter);
+	writer.writeVarint(m_hits_done);
+}
+
+void Defence::read(ByteReader& reader)
+{
+	m_position.x = static_cast<Fixed>(reader.readSigned());
+	m_position.y = static_cast<Fixed>(reader.readSigned());
+	m_counter = static_cast<int>(reader.readVarint());
+	m_hits_done = static_cast<int>(reader.readVarint());
+	if (m_counter < 0 or m_counter >= m_period or m_hits_done < 0 or m_hits_done > m_hits_per_once)
+		throw Error(Problem::FileError);
 }
 
 void Defence::tick()
@@ -81,38 +115,58 @@ bool Defence::ready()
 void Defence::reset()
 {
 	m_hits_done = 0;
+	m_range_tests = 0;
+}
+
+unsigned int Defence::scan(std::list<Entity>::iterator& first, std::list<Entity>::iterator last,
+	std::list<Entity>::iterator (&block)[RANGE_BLOCK])
+{
+	RangeUnit xs[RANGE_BLOCK]{}, ys[RANGE_BLOCK]{};
+	int count = 0;
+	while (first != last and count < RANGE_BLOCK)
+	{
+		FixedVector position = first->getPosition();
+		xs[count] = toRangeUnits(position.x);
+		ys[count] = toRangeUnits(position.y);
+		block[count++] = first++;
+	}
+	m_range_tests += count;
+	return rangeMask(xs, ys, count, toRangeUnits(m_position.x), toRangeUnits(m_position.y),
+		squaredRange(m_radius));
 }
 
 void Shooter::attack(std::list<Entity>::iterator first, std::list<Entity>::iterator last)
 {
-	while (first != last)
+	PROFILE_ZONE("Shooter::attack");
+	std::list<Entity>::iterator block[RANGE_BLOCK];
+	while (first != last and m_hits_done < m_hits_per_once)
 	{
-		if (m_hits_done == m_hits_per_once)
-			break;
-		sf::Vector2f position = first->getPosition();
-		float distance = std::hypot(m_position.x - position.x, m_position.y - position.y);
-		if (distance < m_radius)
+		unsigned int mask = scan(first, last, block);
+		for (int i = 0; mask != 0U and m_hits_done < m_hits_per_once; ++i, mask >>= 1)
 		{
-			first->takeHit(m_force);
-			++m_hits_done;
+			if (mask & 1U)
+			{
+				block[i]->takeHit(m_force);
+				++m_hits_done;
+			}
 		}
-		++first;
 	}
 }
 
 void Freezer::attack(std::list<Entity>::iterator first, std::list<Entity>::iterator last)
 {
-	while (first != last)
+	PROFILE_ZONE("Freezer::attack");
+	std::list<Entity>::iterator block[RANGE_BLOCK];
+	while (first != last and m_hits_done < m_hits_per_once)
 	{
-		if (m_hits_done == m_hits_per_once)
-			break;
-		const sf::Vector2f& position = first->getPosition();
-		float distance = std::hypot(m_position.x - position.x, m_position.y - position.y);
-		if (not first->isFrozen() and distance < m_radius)
+		unsigned int mask = scan(first, last, block);
+		for (int i = 0; mask != 0U and m_hits_done < m_hits_per_once; ++i, mask >>= 1)
 		{
-			first->freeze(m_force);
-			++m_hits_done;
+			if (mask & 1U and not block[i]->isFrozen())
+			{
+				block[i]->freeze(m_force);
+				++m_hits_done;
+			}
 		}
-		++first;
 	}
-}
+}
\ No newline at end of file
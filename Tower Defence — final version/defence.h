@@ -1,5 +1,8 @@
 #pragma once
+#include "binary.h"
 #include "entity.h"
+#include "random.h"
+#include "range.h"
 #include <list>
 #include <mutex>
 #include <filesystem>
@@ -17,35 +20,42 @@ class Defence
 {
 protected:
 
-	float m_radius = 0.f;
+	DefenceType m_type = DefenceType::None;
+	Fixed m_radius = 0;
 	int m_period = 1;
 	int m_counter = 0;
 	int m_force = 0;
 	int m_hits_per_once = 0;
 	int m_hits_done = 0;
+	int m_range_tests = 0; // entities tested in this attack round, for the overlay
 	int m_cost = 0;
-	sf::Vector2f m_position;
-	sf::Vector2f m_shift;
-	sf::Sprite m_sprite;
+	FixedVector m_position;
+
+	unsigned int scan(std::list<Entity>::iterator& first, std::list<Entity>::iterator last,
+		std::list<Entity>::iterator (&block)[RANGE_BLOCK]);
 
 public:
 
 	Defence() = default;
 
+	void setType(DefenceType type);
 	void setRadius(float radius);
 	void setPeriod(int period);
 	void setForce(int force);
 	void setHitsPerOnce(int hits);
 	void setCost(int cost);
-	void setTexture(const sf::Texture& texture);
 	void setPosition(const sf::Vector2f& coords);
-	void setScale(float scale);
-	void setShift(const sf::Vector2f& offset);
-
-	int getCost();
-	float getRadius();
+	void stagger(Random& random);
 
-	void drawYourself(sf::RenderWindow& window);
+	DefenceType getType() const;
+	int getCost() const;
+	float getRadius() const;
+	FixedVector getPosition() const;
+	int getCounter() const;
+	int getHitsDone() const;
+	int getRangeTests() const;
+	void write(ByteWriter& writer) const; // what changes in play; the rest comes from the record
+	void read(ByteReader& reader);
 
 	void tick();
 	bool ready();
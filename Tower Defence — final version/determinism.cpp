@@ -0,0 +1,391 @@
+#include "determinism.h"
+#include "arguments.h"
+#include "error.h"
+#include "headless.h"
+#include "lockstep.h"
+#include "workers.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// one way of playing a game: runs a tick and dumps the state after it, false once the game is over
+	struct Contender
+	{
+		std::string name;
+		std::function<bool(StateDump&)> advance;
+		StateDump dump;
+		std::uint64_t ticks = 0;
+		bool diverged = false;
+		std::string report;
+
+		Contender(const std::string& new_name, std::function<bool(StateDump&)> new_advance) :
+			name(new_name), advance(std::move(new_advance))
+		{
+		}
+	};
+
+	std::function<bool(StateDump&)> simulationContender(const Level& level, const Layout& layout,
+		std::uint64_t seed, Workers* workers)
+	{
+		// as playHeadless plays it
+		auto simulation = std::make_shared<Simulation>(level, workers, seed);
+		simulation->setMoney(INITIAL_MONEY);
+		Command command;
+		command.kind = Command::Kind::Place;
+		for (const Placement& placement : layout)
+		{
+			command.defence = placement.type;
+			command.position = placement.position;
+			simulation->execute(command);
+		}
+		return [simulation](StateDump& dump)
+		{
+			if (simulation->isOver())
+				return false;
+			if (not simulation->isFighting())
+			{
+				Command start;
+				start.kind = Command::Kind::Start;
+				simulation->execute(start);
+			}
+			simulation->tick();
+			simulation->dump(dump);
+			return true;
+		};
+	}
+
+	std::function<bool(StateDump&)> lockstepContender(const Level& level, const Layout& layout, std::uint64_t seed)
+	{
+		auto lockstep = std::make_shared<Lockstep>(level, std::vector<Layout>{ layout }, INITIAL_MONEY, seed);
+		return [lockstep](StateDump& dump)
+		{
+			if (lockstep->isOver())
+				return false;
+			lockstep->tick();
+			lockstep->dump(0, dump);
+			return true;
+		};
+	}
+
+	std::function<bool(StateDump&)> traceContender(std::shared_ptr<const std::vector<std::uint8_t>> bytes,
+		std::size_t position, std::uint64_t ticks)
+	{
+		auto reader = std::make_shared<ByteReader>(*bytes);
+		reader->seek(position);
+		auto previous = std::make_shared<StateDump>();
+		return [bytes, reader, previous, ticks](StateDump& dump) mutable
+		{
+			if (ticks == 0)
+				return false;
+			--ticks;
+			readDump(*reader, dump, *previous);
+			*previous = dump;
+			return true;
+		};
+	}
+
+	void skipGame(ByteReader& reader, std::uint64_t ticks)
+	{
+		StateDump dump, previous;
+		for (; ticks > 0; --ticks)
+		{
+			readDump(reader, dump, previous);
+			std::swap(dump, previous);
+		}
+	}
+}
+
+std::uint64_t hashDump(const StateDump& dump)
+{
+	std::uint64_t hash = hashValue(HASH_BASIS, dump.tick);
+	hash = hashValue(hash, static_cast<std::uint64_t>(dump.health) << 32 | static_cast<std::uint32_t>(dump.money));
+	hash = hashValue(hash, static_cast<std::uint64_t>(dump.leaks) << 32 | static_cast<std::uint32_t>(dump.result));
+	if (dump.over)
+		return hash;
+	hash = hashValue(hash, dump.random);
+	hash = hashValue(hash, static_cast<std::uint64_t>(dump.spawn_counter));
+	hash = hashValue(hash, static_cast<std::uint64_t>(dump.attack_counter) << 32 | static_cast<std::uint32_t>(dump.waves_left));
+	hash = hashValue(hash, static_cast<std::uint64_t>(dump.entities_left) << 32 | static_cast<std::uint32_t>(dump.next_type));
+	hash = hashValue(hash, dump.spawning | dump.fighting << 1);
+	for (const EntityDump& entity : dump.entities)
+	{
+		hash = hashValue(hash, static_cast<std::uint64_t>(static_cast<std::uint32_t>(entity.position.x)) << 32
+			| static_cast<std::uint32_t>(entity.position.y));
+		hash = hashValue(hash, static_cast<std::uint64_t>(entity.type) << 48
+			| static_cast<std::uint64_t>(static_cast<std::uint16_t>(entity.freeze)) << 32
+			| static_cast<std::uint32_t>(entity.health));
+	}
+	for (const DefenceDump& defence : dump.defences)
+		hash = hashValue(hash, static_cast<std::uint64_t>(static_cast<int>(defence.type) + 1) << 32
+			| static_cast<std::uint32_t>(defence.counter));
+	return hash;
+}
+
+void writeDump(ByteWriter& writer, const StateDump& dump, const StateDump& previous)
+{
+	writer.writeVarint(dump.tick);
+	writer.writeWord(dump.random);
+	writer.writeSigned(dump.health);
+	writer.writeSigned(dump.money);
+	writer.writeSigned(dump.leaks);
+	writer.writeSigned(dump.spawn_counter);
+	writer.writeSigned(dump.attack_counter);
+	writer.writeSigned(dump.waves_left);
+	writer.writeSigned(dump.entities_left);
+	writer.writeSigned(dump.next_type);
+	writer.writeByte(static_cast<std::uint8_t>(dump.spawning | dump.fighting << 1 | dump.over << 2));
+	writer.writeByte(static_cast<std::uint8_t>(dump.result));
+	writer.writeVarint(dump.entities.size());
+	for (std::size_t i = 0; i < dump.entities.size(); ++i)
+	{
+		const EntityDump& entity = dump.entities[i];
+		FixedVector origin = i < previous.entities.size() ? previous.entities[i].position : FixedVector();
+		writer.writeVarint(entity.type);
+		writer.writeSigned(entity.health);
+		writer.writeSigned(entity.freeze);
+		writer.writeSigned(static_cast<std::int64_t>(entity.position.x) - origin.x);
+		writer.writeSigned(static_cast<std::int64_t>(entity.position.y) - origin.y);
+	}
+	writer.writeVarint(dump.defences.size());
+	for (const DefenceDump& defence : dump.defences)
+	{
+		writer.writeSigned(static_cast<int>(defence.type));
+		writer.writeSigned(defence.counter);
+	}
+}
+
+void readDump(ByteReader& reader, StateDump& dump, const StateDump& previous)
+{
+	dump.tick = reader.readVarint();
+	dump.random = reader.readWord();
+	dump.health = static_cast<int>(reader.readSigned());
+	dump.money = static_cast<int>(reader.readSigned());
+	dump.leaks = static_cast<int>(reader.readSigned());
+	dump.spawn_counter = static_cast<int>(reader.readSigned());
+	dump.attack_counter = static_cast<int>(reader.readSigned());
+	dump.waves_left = static_cast<int>(reader.readSigned());
+	dump.entities_left = static_cast<int>(reader.readSigned());
+	dump.next_type = static_cast<int>(reader.readSigned());
+	std::uint8_t flags = reader.readByte();
+	dump.spawning = flags & 1;
+	dump.fighting = flags & 2;
+	dump.over = flags & 4;
+	dump.result = static_cast<Result>(reader.readByte());
+	dump.entities.resize(reader.readCount());
+	for (std::size_t i = 0; i < dump.entities.size(); ++i)
+	{
+		EntityDump& entity = dump.entities[i];
+		FixedVector origin = i < previous.entities.size() ? previous.entities[i].position : FixedVector();
+		entity.type = static_cast<int>(reader.readVarint());
+		entity.health = static_cast<int>(reader.readSigned());
+		entity.freeze = static_cast<int>(reader.readSigned());
+		entity.position.x = static_cast<Fixed>(origin.x + reader.readSigned());
+		entity.position.y = static_cast<Fixed>(origin.y + reader.readSigned());
+	}
+	dump.defences.resize(reader.readCount());
+	for (DefenceDump& defence : dump.defences)
+	{
+		defence.type = static_cast<DefenceType>(reader.readSigned());
+		defence.counter = static_cast<int>(reader.readSigned());
+	}
+}
+
+std::string diffDumps(const StateDump& expected, const StateDump& actual)
+{
+	std::ostringstream lines;
+	int differences = 0;
+	auto field = [&](const std::string& name, auto wanted, auto found)
+	{
+		if (wanted == found)
+			return;
+		if (differences++ < DIFFERENCES_SHOWN)
+			lines << "\t\t" << name << ": " << found << " (the reference: " << wanted << ")" << std::endl;
+	};
+	field("tick", expected.tick, actual.tick);
+	field("health", expected.health, actual.health);
+	field("money", expected.money, actual.money);
+	field("leaks", expected.leaks, actual.leaks);
+	field("over", expected.over, actual.over);
+	field("result", static_cast<int>(expected.result), static_cast<int>(actual.result));
+	if (expected.over and actual.over)
+		return lines.str();
+	field("random state", expected.random, actual.random);
+	field("spawn counter", expected.spawn_counter, actual.spawn_counter);
+	field("attack counter", expected.attack_counter, actual.attack_counter);
+	field("waves left", expected.waves_left, actual.waves_left);
+	field("entities left", expected.entities_left, actual.entities_left);
+	field("next entity type", expected.next_type, actual.next_type);
+	field("spawning", expected.spawning, actual.spawning);
+	field("fighting", expected.fighting, actual.fighting);
+	field("entities", expected.entities.size(), actual.entities.size());
+	for (std::size_t i = 0; i < std::min(expected.entities.size(), actual.entities.size()); ++i)
+	{
+		const EntityDump& wanted = expected.entities[i];
+		const EntityDump& found = actual.entities[i];
+		std::string name = "entity " + std::to_string(i) + " ";
+		field(name + "type", wanted.type, found.type);
+		field(name + "health", wanted.health, found.health);
+		field(name + "freeze", wanted.freeze, found.freeze);
+		field(name + "x", wanted.position.x, found.position.x);
+		field(name + "y", wanted.position.y, found.position.y);
+	}
+	field("defences", expected.defences.size(), actual.defences.size());
+	for (std::size_t i = 0; i < std::min(expected.defences.size(), actual.defences.size()); ++i)
+	{
+		std::string name = "defence " + std::to_string(i) + " ";
+		field(name + "type", static_cast<int>(expected.defences[i].type), static_cast<int>(actual.defences[i].type));
+		field(name + "counter", expected.defences[i].counter, actual.defences[i].counter);
+	}
+	if (differences > DIFFERENCES_SHOWN)
+		lines << "\t\tand " << differences - DIFFERENCES_SHOWN << " more" << std::endl;
+	return lines.str();
+}
+
+int runDeterminism(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cout << "Usage: determinism \"<map name>\" \"<level name>\" [<games count> [<trace file>]]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::string map_name = argv[2], level_name = argv[3];
+		int games = argc > 4 ? std::max(1, parseInt(argv[4])) : REFERENCES_NUMBER;
+		std::filesystem::path trace_path = argc > 5 ? argv[5] : "";
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		manager_ref.loadMap(map_name);
+		Level level;
+		manager_ref.loadLevel(level_name, level);
+		std::vector<Layout> layouts = referenceLayouts(INITIAL_MONEY);
+
+		// a trace to compare with, or to record
+		bool recording = not trace_path.empty() and not std::filesystem::exists(trace_path);
+		auto trace = std::make_shared<std::vector<std::uint8_t>>();
+		ByteReader trace_reader(nullptr, 0);
+		ByteWriter record;
+		if (not trace_path.empty() and not recording)
+		{
+			readFile(trace_path, *trace);
+			trace_reader = ByteReader(*trace);
+			if (trace_reader.readWord() != TRACE_MAGIC or trace_reader.readVarint() != TRACE_VERSION
+				or trace_reader.readString() != map_name or trace_reader.readString() != level_name
+				or trace_reader.readVarint() < static_cast<std::uint64_t>(games))
+				throw Error(Problem::FileError);
+		}
+		else if (recording)
+		{
+			record.writeWord(TRACE_MAGIC);
+			record.writeVarint(TRACE_VERSION);
+			record.writeString(map_name);
+			record.writeString(level_name);
+			record.writeVarint(games);
+		}
+
+		int threads = static_cast<int>(std::max(2U, std::thread::hardware_concurrency()));
+		Workers pair(1), crew(threads - 1);
+		int differing = 0, contenders = 0;
+		for (int game = 0; game < games; ++game)
+		{
+			const Layout& layout = layouts[game % REFERENCES_NUMBER];
+			std::uint64_t seed = game + 1;
+			std::function<bool(StateDump&)> reference = simulationContender(level, layout, seed, nullptr);
+			std::vector<Contender> others;
+			others.push_back({ "again", simulationContender(level, layout, seed, nullptr) });
+			others.push_back({ "2 threads", simulationContender(level, layout, seed, &pair) });
+			if (threads > 2)
+				others.push_back({ std::to_string(threads) + " threads", simulationContender(level, layout, seed, &crew) });
+			others.push_back({ "lockstep", lockstepContender(level, layout, seed) });
+			if (not trace_path.empty() and not recording)
+			{
+				std::uint64_t ticks = trace_reader.readVarint();
+				others.push_back({ "trace", traceContender(trace, trace_reader.getPosition(), ticks) });
+				skipGame(trace_reader, ticks);
+			}
+
+			// all side by side, a tick at a time, so that nothing has to be kept but the last dumps
+			StateDump expected, previous;
+			ByteWriter recorded;
+			std::uint64_t ticks = 0;
+			while (reference(expected))
+			{
+				++ticks;
+				std::uint64_t hash = hashDump(expected);
+				for (Contender& contender : others)
+				{
+					if (contender.diverged)
+						continue;
+					bool running = contender.advance(contender.dump);
+					if (running and hashDump(contender.dump) == hash)
+					{
+						++contender.ticks;
+						continue;
+					}
+					contender.diverged = true;
+					std::ostringstream report;
+					report << "differs from tick " << expected.tick << ":" << std::endl;
+					if (running)
+						report << diffDumps(expected, contender.dump);
+					else
+						report << "\t\tthe game ended at tick " << contender.dump.tick << std::endl;
+					contender.report = report.str();
+				}
+				if (recording)
+				{
+					writeDump(recorded, expected, previous);
+					previous = expected;
+				}
+			}
+			if (recording)
+			{
+				record.writeVarint(ticks);
+				record.writeBytes(recorded.getBytes().data(), recorded.getSize());
+			}
+
+			std::cout << "Game " << game + 1 << " (" << REFERENCE_NAMES[game % REFERENCES_NUMBER]
+				<< ", seed " << seed << "): " << ticks << " ticks, "
+				<< (expected.result == Result::Victory ? "victory" : "failure") << std::endl;
+			for (Contender& contender : others)
+			{
+				// one still running after the reference has ended differs, too
+				if (not contender.diverged and contender.advance(contender.dump))
+				{
+					contender.diverged = true;
+					contender.report = "differs: the game went on after tick " + std::to_string(expected.tick) + "\n";
+				}
+				++contenders;
+				differing += contender.diverged;
+				std::cout << "\t" << contender.name << ": " << (contender.diverged ? contender.report : "the same\n");
+			}
+		}
+
+		if (recording)
+		{
+			writeFile(trace_path, record.getBytes());
+			std::cout << "Trace of " << record.getSize() << " bytes recorded." << std::endl;
+		}
+		if (differing > 0)
+		{
+			std::cout << differing << " of " << contenders << " runs differed from the reference." << std::endl;
+			return 1;
+		}
+		std::cout << "All " << contenders << " runs agreed with the reference at every tick." << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "binary.h"
+#include "simulation.h"
+#include <cstdint>
+#include <string>
+
+// Determinism checks, to prove that a change to the simulation left every game as it was.
+// The reference layouts are played on one map and level, each game tick by tick by several
+// contenders side by side: the plain simulation again, the simulation with attacks spread
+// over 2 and over all hardware threads, and the lockstep batch. After every tick the full
+// state of each is dumped and hashed, and at the first tick where a hash differs from the
+// reference's, the fields that differ are listed. Once a game is over, only its outcome
+// counts: the tick, health, money, leaks and result; the rest is left as each way of
+// running games happens to leave it.
+// With a trace file, the reference's dumps are recorded when the file does not exist yet,
+// and otherwise compared with as one more contender, so that a build can be checked against
+// one from before a change. A trace takes a few bytes per entity and tick.
+// Usage: determinism "<map name>" "<level name>" [<games count> [<trace file>]]
+
+const std::uint32_t TRACE_MAGIC = 0x54444454; // "TDDT"
+const int TRACE_VERSION = 1;
+const int DIFFERENCES_SHOWN = 16;
+
+std::uint64_t hashDump(const StateDump& dump);
+// positions are written relative to the entity in the same place in the dump before
+void writeDump(ByteWriter& writer, const StateDump& dump, const StateDump& previous);
+void readDump(ByteReader& reader, StateDump& dump, const StateDump& previous);
+std::string diffDumps(const StateDump& expected, const StateDump& actual); // a line per field, "" when equal
+
+int runDeterminism(int argc, char* argv[]);
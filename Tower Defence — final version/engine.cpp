@@ -1,57 +1,114 @@
 #include "engine.h"
+#include "arguments.h"
 #include "error.h"
+#include "profile.h"
+#include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <numbers>
+#include <thread>
 
 #include <iostream>
 
+// "address[:port]", the port left as it is when not given
+static void splitAddress(const std::string& text, std::string& address, unsigned short& port)
+{
+	address = text;
+	std::size_t colon = address.rfind(':');
+	if (colon != std::string::npos)
+	{
+		port = parsePort(address.substr(colon + 1));
+		address.resize(colon);
+	}
+}
+
 void Engine::serveEvents()
 {
 	static sf::Event s_event;
+	if (m_paused)
+	{
+		// nothing moves during a pause, so sleep until the player does something
+		bool woken = m_window_ptr->waitEvent(s_event);
+		m_hitches.resume();
+		if (woken)
+			serveEvent(s_event);
+	}
 	while (m_window_ptr->pollEvent(s_event))
+		serveEvent(s_event);
+}
+
+void Engine::serveEvent(const sf::Event& event)
+{
+	switch (event.type)
 	{
-		switch (s_event.type)
+	case sf::Event::Closed:
+		m_window_ptr->close();
+		break;
+	case sf::Event::KeyPressed:
+		switch (event.key.code)
 		{
-		case sf::Event::Closed:
+		case sf::Keyboard::Escape:
 			m_window_ptr->close();
 			break;
-		case sf::Event::KeyPressed:
-			switch (s_event.key.code)
+		case sf::Keyboard::P:
+		case sf::Keyboard::Pause:
+			m_paused = not m_paused;
+			m_paused.notify_all();
+			m_pause_drawn = false;
+			break;
+		case sf::Keyboard::F3:
+			m_overlay.toggle();
+			break;
+		case sf::Keyboard::F5:
+			m_save_requested = true;
+			break;
+		case sf::Keyboard::F9:
+			// a co-op game cannot go back on its own
+			if (local() and std::filesystem::exists(savePath(QUICKSAVE_NAME)))
 			{
-			case sf::Keyboard::Escape:
-				m_window_ptr->close();
-				break;
+				quickload();
+				m_hitches.resume();
 			}
 			break;
-		case sf::Event::MouseButtonPressed:
-			if (s_event.mouseButton.button == sf::Mouse::Left)
-				serveLeftButton();
-			break;
+		default:
+			// both players of a co-op game run at the same pace, and a stream at its own
+			if (local() and event.key.code >= sf::Keyboard::Num1 and event.key.code < sf::Keyboard::Num1 + SPEEDS_NUMBER)
+				setSpeed(SPEEDS[event.key.code - sf::Keyboard::Num1]);
 		}
+		break;
+	case sf::Event::Resized:
+	case sf::Event::GainedFocus:
+		m_pause_drawn = false;
+		break;
+	case sf::Event::MouseButtonPressed:
+		if (event.mouseButton.button == sf::Mouse::Left and not m_paused and m_spectator == nullptr)
+			serveLeftButton();
+		break;
 	}
 }
 
 void Engine::serveLeftButton()
 {
-	sf::Vector2f mouse_position =
-		static_cast<sf::Vector2f>(sf::Mouse::getPosition(*m_window_ptr));
-	if (not m_fighting and m_start_button.contains(mouse_position))
+	sf::Vector2i mouse = sf::Mouse::getPosition(*m_window_ptr);
+	sf::Vector2f mouse_position = static_cast<sf::Vector2f>(mouse);
+	const Snapshot& snapshot = m_snapshots.front();
+	if (not snapshot.fighting and m_start_button.contains(mouse_position))
 	{
-		m_spawning = true;
-		m_fighting = true;
-		m_start_button.toggle();
+		Command command;
+		command.kind = Command::Kind::Start;
+		send(command);
 	}
-	if (m_holder == nullptr and mouse_position.x > m_world_ref.getDimensions().x)
+	if (m_selected == DefenceType::None and mouse_position.x > m_world_ref.getDimensions().x)
 	{
 		DefenceType defence_type = m_shop_ref.select(mouse_position);
 		if (defence_type != DefenceType::None)
 		{
 			const DefenceRecord& record = m_manager_ref.getDefenceRecord(defence_type);
-			if (m_money >= record.cost)
+			if (snapshot.money >= record.cost)
 			{
-				m_shop_ref.assignDefence(defence_type, m_holder);
+				m_selected = defence_type;
 				m_shop_ref.toggleButton();
-				float radius = m_holder->getRadius();
+				float radius = record.radius;
 				m_defence_range = std::make_unique<sf::CircleShape>();
 				m_defence_range->setFillColor(RANGE_COLOR);
 				m_defence_range->setRadius(radius);
@@ -59,148 +116,263 @@ void Engine::serveLeftButton()
 			}
 		}
 	}
-	else if (m_holder != nullptr and mouse_position.x < m_world_ref.getDimensions().x)
+	else if (m_selected != DefenceType::None and mouse_position.x < m_world_ref.getDimensions().x)
 	{
-		m_money -= m_holder->getCost();
-		m_money_bar.setString("Money = " + std::to_string(m_money));
-		m_holder->setPosition(mouse_position);
-		m_defences.emplace_back(m_holder.release());
+		Command command;
+		command.kind = Command::Kind::Place;
+		command.defence = m_selected;
+		command.position = mouse;
+		send(command);
+		m_selected = DefenceType::None;
 		m_shop_ref.toggleButton();
-		m_dividers.emplace_back(m_entities.end());
 		m_defence_range.reset();
 	}
 }
 
-void Engine::spawnEntity()
+void Engine::send(const Command& command)
 {
-	if (m_level.empty())
+	std::lock_guard<std::mutex> lock(m_commands_mutex);
+	m_commands.push_back(command);
+}
+
+void Engine::setSpeed(int speed)
+{
+	m_speed = speed;
+	if (speed == 1)
+		m_window_ptr->setTitle(m_title);
+	else if (speed == 0)
+		m_window_ptr->setTitle(m_title + " (max speed)");
+	else
+		m_window_ptr->setTitle(m_title + " (" + std::to_string(speed) + "x)");
+}
+
+void Engine::showForecast()
+{
+	Forecast forecast;
+	m_forecast_ready = m_forecaster.latest(forecast);
+	if (not m_forecast_ready or forecast.request == m_shown_forecast)
 		return;
-	int entityIndex = m_level.front().front().index;
-	if (--m_level.front().front().count == 0)
+	m_shown_forecast = forecast.request;
+	auto tenths = [](float value) -> std::string
 	{
-		m_level.front().pop();
-		if (m_level.front().empty())
-		{
-			m_level.pop();
-			m_spawning = false;
-		}
-	}
-	if (m_defences.empty())
+		int rounded = static_cast<int>(value * 10.f + .5f);
+		return std::to_string(rounded / 10) + "." + std::to_string(rounded % 10);
+	};
+	std::string text = "Next wave: " + tenths(forecast.leaks) + " leaks\n"
+		+ "-" + tenths(forecast.health_loss) + " health (worst -" + std::to_string(forecast.worst_health_loss) + ")\n";
+	if (forecast.failures > 0)
+		text += "lost in " + std::to_string(forecast.failures) + " of " + std::to_string(forecast.runs) + " runs\n";
+	text += std::to_string(static_cast<long long>(forecast.ticks_per_second / 1000.)) + "k ticks/s";
+	m_forecast_text.setString(text);
+	m_forecast_text.setPosition(m_forecast_text.getPosition().x,
+		m_start_button.m_background.getPosition().y - m_forecast_text.getLocalBounds().height - .2f * TEXT_SIZE);
+}
+
+void Engine::prepareSprites()
+{
+	m_entity_sprites.clear();
+	for (int i = 0; i < m_manager_ref.getEntitiesNumber(); ++i)
 	{
-		m_entities.emplace_back(entityIndex);
-		m_dividers.front() = m_entities.begin();
+		const EntityRecord& record = m_manager_ref.getEntityRecord(i);
+		sf::Sprite& sprite = m_entity_sprites.emplace_back(record.texture);
+		sprite.setScale(record.scale, record.scale);
+		sprite.setOrigin(.5f * record.dimensions);
 	}
-	else
+	for (int i = 0; i < DEFENCES_NUMBER; ++i)
 	{
-		m_entities.emplace(m_dividers[m_inserter], entityIndex);		
-		for (int i = m_inserter - 1; i >= 0; --i)
-		{
-			if (m_dividers[i] == m_dividers[m_inserter])
-				--m_dividers[i];
-		}
-		if (++m_inserter == m_dividers.size())
-			m_inserter = 1;
+		const DefenceRecord& record = m_manager_ref.getDefenceRecord(static_cast<DefenceType>(i));
+		sf::Sprite& sprite = m_defence_sprites[i];
+		sprite.setTexture(record.texture);
+		sprite.setScale(record.scale, record.scale);
+		sprite.setOrigin(.5f * record.dimensions);
 	}
 }
 
-void Engine::doAttacking()
+void Engine::step()
 {
-	for (int i = 0; i < m_defences.size(); ++i)
-		m_defences[i]->tick();
-
-	std::vector<std::thread> threads;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (m_session != nullptr)
+		m_session->advance();
+	else
+		m_simulation->tick();
+	if (m_recorder != nullptr)
+		m_recorder->observe(*m_simulation);
+	if (m_streamed)
+		getStream()->offer(*m_simulation);
+	if (m_exported)
+		getExport()->offer(*m_simulation);
+	m_hitches.recordTick(std::chrono::steady_clock::now() - start);
+}
 
-	auto make_attack = [] (Defence& def,
-		std::list<Entity>::iterator first,
-		std::list<Entity>::iterator last)
-	{
-		def.attack(first, last);
-	};
+void Engine::save(const std::string& name)
+{
+	SavedGame game;
+	game.map_name = m_map_name;
+	game.level_name = m_level_name;
+	captureGame(*m_simulation, game);
+	m_autosaver.save(savePath(name), std::move(game));
+}
 
-	for (int i = 0; i < m_defences.size(); ++i)
+void Engine::simulate(std::stop_token stop)
+{
+	PROFILE_THREAD("simulation");
+	// fixed timestep: real time is accumulated and spent in whole ticks, so the game
+	// runs at the tick rate whatever the frame rate is and however late the OS wakes us;
+	// fast-forward shortens the tick period and wakes once a frame for a batch of ticks.
+	// The rules are counted in ticks, so the tick rate is also the speed of the game
+	using Clock = std::chrono::steady_clock;
+	const Clock::duration frame = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::nanoseconds(1000000000LL / m_tick_rate));
+	std::vector<Command> commands;
+	Clock::time_point previous = Clock::now();
+	Clock::duration accumulator = frame;
+	bool was_idle = false; // so that a forecast is asked for at once
+	bool was_fighting = m_simulation->isFighting();
+	try
 	{
-		bool anyone_ready = false;
-		for (int j = 0; j < m_defences.size(); ++j)
+		while (not stop.stop_requested() and not decided())
 		{
-			if (m_defences[j]->ready())
+			if (m_paused)
 			{
-				anyone_ready = true;
-				int k = (j + i) % m_defences.size();
-				threads.emplace_back(make_attack,
-					std::ref(*m_defences[j]),
-					m_dividers[k],
-					m_dividers[k + 1]);
+				m_paused.wait(true);
+				previous = Clock::now();
+				continue;
 			}
-		}
-		for (int j = 0; j < threads.size(); ++j)
-			threads[j].join();
-		threads.clear();
-		if (not anyone_ready)
-			break;
-	}
-
-	auto reset_all = [](std::vector<std::unique_ptr<Defence>>::iterator first,
-		std::vector<std::unique_ptr<Defence>>::iterator last)
-	{
-		while (first != last)
-		{
-			(*first)->reset();
-			++first;
-		}
-	};
-	
-	std::jthread jthread(reset_all, m_defences.begin(), m_defences.end());
-
-	auto it = m_entities.begin();
-	while (it != m_entities.end())
-	{
-		if (it->isAlive())
-			++it;
-		else
-		{
-			for (int i = 0; i < m_dividers.size(); ++i)
+			int speed = m_speed;
+			Clock::duration period = speed > 0 ? frame / speed : frame;
+			Clock::time_point now = Clock::now();
+			accumulator += now - previous;
+			m_behind = speed == 0 or accumulator > MAX_CATCH_UP * frame;
+			accumulator = std::min(accumulator, MAX_CATCH_UP * frame);
+			previous = now;
+			{
+				std::lock_guard<std::mutex> lock(m_commands_mutex);
+				commands.swap(m_commands);
+			}
+			if (m_save_requested.exchange(false))
+				save(QUICKSAVE_NAME);
+			bool commanded = not commands.empty();
+			for (const Command& command : commands)
+			{
+				if (m_session != nullptr)
+					m_session->give(command);
+				else
+				{
+					if (m_recorder != nullptr)
+						m_recorder->record(*m_simulation, command);
+					m_simulation->execute(command);
+				}
+			}
+			commands.clear();
+			bool ticked = false;
+			if (speed == 0)
+			{
+				// as fast as possible: tick for a frame's worth of time, then show the result
+				while (Clock::now() - now < frame and not m_simulation->isOver())
+					step();
+				ticked = true;
+				accumulator = Clock::duration::zero();
+				now = Clock::now();
+			}
+			while (accumulator >= period and not m_simulation->isOver())
+			{
+				// in co-op, a tick may have to wait for the other player's commands
+				if (m_session != nullptr and not m_session->canAdvance())
+					break;
+				step();
+				accumulator -= period;
+				ticked = true;
+			}
+			if (m_session != nullptr)
+			{
+				// a late command of the other player may have changed the past, and the game
+				// is over only when the other player cannot change that any more
+				bool rolled_back = m_session->exchange();
+				ticked = ticked or rolled_back or m_session->isDecided();
+			}
+			if (ticked)
 			{
-				if (m_dividers[i] == it)
-					++m_dividers[i];
+				Snapshot& snapshot = m_snapshots.back();
+				m_simulation->capture(snapshot);
+				if (m_session != nullptr)
+					snapshot.over = m_session->isDecided();
+				snapshot.stamp = now - accumulator;
+				m_snapshots.publish();
 			}
-			m_money += m_manager_ref.getEntityRecord(it->getType()).prize;
-			it = m_entities.erase(it);
+			// between waves, every change of the game is followed by a new forecast,
+			// and the end of a wave by an autosave
+			bool fighting = m_simulation->isFighting();
+			bool idle = not fighting and not m_simulation->isOver();
+			if (idle and was_fighting)
+				save(AUTOSAVE_NAME);
+			was_fighting = fighting;
+			if (idle and (commanded or not was_idle))
+				m_forecaster.request(std::make_unique<Simulation>(*m_simulation));
+			else if (was_idle and not idle)
+				m_forecaster.cancel();
+			was_idle = idle;
+			if (m_session != nullptr and accumulator >= period)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1)); // waiting for the other player
+			else if (speed == 1)
+				std::this_thread::sleep_until(now + period - accumulator);
+			else if (speed > 1)
+				std::this_thread::sleep_until(now + frame);
 		}
 	}
-	m_money_bar.setString("Money = " + std::to_string(m_money));
+	catch (...)
+	{
+		m_simulation_error = std::current_exception();
+		m_simulation_failed = true;
+	}
+}
+
+void Engine::startSimulation()
+{
+	// timed from the start whether or not the overlay is shown, as the hitch recorder
+	// takes the phases of every frame and the overlay may be turned on at any moment
+	m_simulation->setTimed(true);
+	m_simulation->capture(m_snapshots.back());
+	m_snapshots.back().stamp = std::chrono::steady_clock::now();
+	m_snapshots.publish();
+	m_snapshots.update();
+	m_simulation_thread = std::jthread([this](std::stop_token stop) { simulate(stop); });
+}
+
+void Engine::stopSimulation()
+{
+	if (not m_simulation_thread.joinable())
+		return;
+	m_forecaster.cancel();
+	m_simulation_thread.request_stop();
+	m_paused = false;
+	m_paused.notify_all();
+	m_simulation_thread.join();
 }
 
 Engine::Engine() :
 	m_world_ref(World::getInstance()),
 	m_manager_ref(Manager::getInstance()),
+	m_workers(std::max(1U, std::thread::hardware_concurrency()) - 1),
 	m_shop_ref(Shop::getInstance())
 {
-	std::srand(static_cast<unsigned int>(std::time(0)));
-
 	m_window_ptr = std::make_unique<sf::RenderWindow>(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT),
 		"Tower Defence: Setup", sf::Style::Close);
-	m_window_ptr->setFramerateLimit(FREQUENCY);
+	m_window_ptr->setFramerateLimit(m_frame_rate);
 	m_world_ref.setDimensions(WORLD_WIDTH, WORLD_HEIGHT);
 
-	m_spawning = false;
-	m_fighting = false;
-
 	const sf::Font& font = m_manager_ref.shareFont();
 
-	m_health = INITIAL_HEALTH;
 	m_health_bar.setFont(font);
-
-	m_health_bar.setString("Health = " + std::to_string(m_health));
 	m_health_bar.setFillColor(HEALTH_COLOR);
 	m_health_bar.setPosition(WORLD_WIDTH, 0.f);
 
-	m_money = INITIAL_MONEY;
-
 	m_money_bar.setFont(font);
-	m_money_bar.setString("Money = " + std::to_string(m_money));
 	m_money_bar.setFillColor(MONEY_COLOR);
 	m_money_bar.setPosition(WORLD_WIDTH, TEXT_SIZE);
 
+	m_overlay.setFont(font);
+	m_overlay.setCorner(WORLD_WIDTH, 0.f);
+
 	float button_width = static_cast<float>(WINDOW_WIDTH) - WORLD_WIDTH;
 	float button_height = button_width / std::numbers::phi_v<float>;
 
@@ -211,45 +383,304 @@ Engine::Engine() :
 	m_start_button.m_text.setString("Start");
 	m_start_button.m_text.setFont(m_manager_ref.shareFont());
 
+	m_forecast_text.setFont(font);
+	m_forecast_text.setCharacterSize(static_cast<unsigned int>(.3f * TEXT_SIZE));
+	m_forecast_text.setFillColor(sf::Color::White);
+	m_forecast_text.setPosition(WORLD_WIDTH + .1f * TEXT_SIZE, WORLD_HEIGHT - button_height);
+
+	m_pause_text.setFont(font);
+	m_pause_text.setString("Paused (press P to resume)");
+	m_pause_text.setFillColor(PAUSE_COLOR);
+	m_pause_text.setOutlineColor(sf::Color::Black);
+	m_pause_text.setOutlineThickness(OUTLINE_THICKNESS);
+	m_pause_text.setStyle(sf::Text::Style::Bold);
+	sf::FloatRect bounds = m_pause_text.getLocalBounds();
+	m_pause_text.setPosition(.5f * (WORLD_WIDTH - bounds.width), .5f * (WORLD_HEIGHT - bounds.height));
+
 	m_shop_ref.setPosition(WORLD_WIDTH, 2 * TEXT_SIZE);
 	m_shop_ref.setSize(button_width, WORLD_HEIGHT - button_height - 2 * TEXT_SIZE);
 
-	m_dividers.push_back(m_entities.begin());
-	m_holder = nullptr;
-
 	m_result = Result::Interrupt;
 	m_game_over = false;
 }
 
+Engine::~Engine()
+{
+	stopSimulation();
+}
+
+void Engine::setTickRate(int rate)
+{
+	if (rate <= 0)
+		throw Error(Problem::BadArgument);
+	if (not m_simulation_thread.joinable())
+		m_tick_rate = static_cast<unsigned int>(rate);
+}
+
+void Engine::setFrameRate(int rate)
+{
+	if (rate <= 0)
+		throw Error(Problem::BadArgument);
+	m_frame_rate = static_cast<unsigned int>(rate);
+	m_window_ptr->setFramerateLimit(m_frame_rate);
+}
+
+void Engine::setReplayPath(const std::string& path)
+{
+	m_replay_path = path;
+}
+
+void Engine::setLoadPath(const std::string& path)
+{
+	m_load_path = path;
+}
+
+void Engine::setHostPort(unsigned short port)
+{
+	m_host_port = port;
+}
+
+void Engine::setJoinAddress(const std::string& address)
+{
+	m_join_address = address;
+}
+
+void Engine::connect(std::uint64_t& seed)
+{
+	m_session = std::make_unique<Session>();
+	if (not m_join_address.empty())
+	{
+		// the host has chosen the map, the level and the seed
+		m_window_ptr->setTitle("Tower Defence: Joining " + m_join_address);
+		std::string address;
+		unsigned short port = NETPLAY_PORT;
+		splitAddress(m_join_address, address, port);
+		Hello hello = m_session->join(address, port);
+		m_map_name = hello.map_name;
+		m_level_name = hello.level_name;
+		seed = hello.seed;
+		m_manager_ref.loadMap(m_map_name);
+		m_manager_ref.loadLevel(m_level_name, m_level);
+	}
+	else
+	{
+		m_window_ptr->setTitle("Tower Defence: Waiting for the other player on port " + std::to_string(m_host_port));
+		Hello hello;
+		hello.map_name = m_map_name;
+		hello.level_name = m_level_name;
+		hello.seed = seed;
+		hello.data_hash = hashGameData(m_map_name, m_level_name);
+		m_session->host(m_host_port, hello, [this]()
+			{
+				sf::Event event;
+				while (m_window_ptr->pollEvent(event))
+				{
+					if (event.type == sf::Event::Closed)
+					{
+						m_window_ptr->close();
+						return false;
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				return true;
+			});
+	}
+}
+
+bool Engine::decided() const
+{
+	return m_session != nullptr ? m_session->isDecided() : m_simulation->isOver();
+}
+
+bool Engine::local() const
+{
+	return m_session == nullptr and m_spectator == nullptr;
+}
+
+void Engine::setWatchAddress(const std::string& address)
+{
+	m_watch_address = address;
+}
+
+void Engine::setHitchBudget(double budget)
+{
+	m_hitches.setBudget(budget);
+}
+
+void Engine::watch()
+{
+	// polled once a frame: a viewer has nothing else to do, so it needs no thread
+	Snapshot& snapshot = m_snapshots.back();
+	if (m_spectator->receive(snapshot))
+	{
+		snapshot.stamp = std::chrono::steady_clock::now();
+		m_snapshots.publish();
+		if (m_spectator->getMapName() != m_map_name)
+		{
+			m_map_name = m_spectator->getMapName();
+			m_manager_ref.loadMap(m_map_name);
+			m_title = "Watching: " + m_map_name;
+			m_window_ptr->setTitle(m_title);
+		}
+	}
+	else if (not m_spectator->isConnected())
+		m_game_over = true;
+}
+
+std::unique_ptr<Simulation> Engine::rebuild(const SavedGame& game, Level& level)
+{
+	m_manager_ref.loadLevel(game.level_name, level);
+	auto simulation = std::make_unique<Simulation>(level, &m_workers);
+	restoreGame(game, *simulation);
+	return simulation;
+}
+
+void Engine::restore(const SavedGame& game)
+{
+	if (game.map_name != m_map_name)
+	{
+		m_manager_ref.loadMap(game.map_name);
+		// a map that fails its checks is left unloaded without a word
+		if (m_manager_ref.getMapName() != game.map_name)
+			throw Error(Problem::FileError);
+	}
+	Level level;
+	adopt(game, level, rebuild(game, level));
+}
+
+void Engine::quickload()
+{
+	// a bad quicksave must not end the game in play: everything that can fail is done
+	// before that game stops, or undone if it has to stop first
+	SavedGame game;
+	Level level;
+	std::unique_ptr<Simulation> simulation;
+	try
+	{
+		loadGame(savePath(QUICKSAVE_NAME), game);
+		if (game.map_name == m_map_name)
+			simulation = rebuild(game, level);
+	}
+	catch (Error)
+	{
+		m_window_ptr->setTitle(m_title + " (the quicksave could not be loaded)");
+		return;
+	}
+	// stopping wakes a paused simulation, and the game loaded stays paused as this one was
+	bool paused = m_paused;
+	stopSimulation();
+	bool failed = false;
+	if (simulation != nullptr)
+		adopt(game, level, std::move(simulation));
+	else
+	{
+		// another map cannot be loaded under a running simulation
+		std::string map_name = m_map_name;
+		try
+		{
+			restore(game);
+		}
+		catch (Error)
+		{
+			if (m_manager_ref.getMapName() != map_name)
+				m_manager_ref.loadMap(map_name);
+			failed = true;
+		}
+	}
+	m_paused = paused;
+	m_pause_drawn = false;
+	startSimulation();
+	if (failed)
+		m_window_ptr->setTitle(m_title + " (the quicksave could not be loaded)");
+}
+
+void Engine::adopt(const SavedGame& game, Level& level, std::unique_ptr<Simulation> simulation)
+{
+	m_simulation = std::move(simulation);
+	m_level = std::move(level);
+	m_map_name = game.map_name;
+	m_level_name = game.level_name;
+	// a replay starts from the first tick, so it cannot go on across a restored state
+	m_recorder.reset();
+	m_replay_path.clear();
+	m_game_over = false;
+	m_title = "Gameplay: " + m_map_name + ", " + m_level_name;
+	setSpeed(m_speed);
+}
+
 void Engine::prepare()
 {
+	// co-op games start afresh, and the one who joins plays what the host chose
+	bool coop = m_host_port != 0 or not m_join_address.empty();
+	if (coop)
+		m_load_path.clear();
+	bool watching = not m_watch_address.empty();
+	bool choose = m_load_path.empty() and m_join_address.empty() and not watching;
+	std::uint64_t seed = static_cast<std::uint64_t>(std::time(0));
 	try
 	{
 		m_manager_ref.loadFont();
 
-		std::string map_name, level_name;
-
 		m_manager_ref.checkMaps();
-		m_manager_ref.loadMap(*m_window_ptr, map_name);
+		if (choose)
+			m_manager_ref.loadMap(*m_window_ptr, m_map_name);
 
 		m_manager_ref.readEntitiesData();
 
 		m_manager_ref.checkLevels();
-		m_manager_ref.loadLevel(*m_window_ptr, m_level, level_name);
-
-		m_window_ptr->setTitle("Gameplay: " + map_name + ", " + level_name);
+		if (choose)
+			m_manager_ref.loadLevel(*m_window_ptr, m_level, m_level_name);
 
 		m_manager_ref.readDefencesData();
 
 		m_shop_ref.makeButtons(m_manager_ref.shareFont());
+
+		if (coop)
+			connect(seed);
+		else if (watching)
+		{
+			std::string address;
+			unsigned short port = STREAM_PORT;
+			splitAddress(m_watch_address, address, port);
+			m_window_ptr->setTitle("Tower Defence: Watching " + m_watch_address);
+			m_spectator = std::make_unique<Spectator>();
+			m_spectator->connect(address, port);
+		}
 	}
 	catch (Error err)
 	{
 		if (err.problem() == Problem::Interrupt)
+		{
 			m_game_over = true;
+			return;
+		}
 		else
 			throw;
 	}
+	prepareSprites();
+	if (watching)
+		return;
+	if (not m_load_path.empty())
+	{
+		SavedGame game;
+		loadGame(m_load_path, game);
+		restore(game);
+	}
+	else
+	{
+		m_title = "Gameplay: " + m_map_name + ", " + m_level_name;
+		if (m_session != nullptr)
+			m_title += m_session->getPlayer() == 0 ? " (co-op host)" : " (co-op guest)";
+		m_window_ptr->setTitle(m_title);
+		m_simulation = std::make_unique<Simulation>(m_level, &m_workers, seed);
+		if (m_session != nullptr)
+			m_session->start(*m_simulation);
+		else if (not m_replay_path.empty())
+			m_recorder = std::make_unique<Recorder>(m_map_name, m_level_name, seed, m_simulation->getMoney());
+	}
+	m_streamed = getStream() != nullptr and getStream()->begin();
+	m_exported = getExport() != nullptr and getExport()->begin();
+	startSimulation();
 }
 
 bool Engine::running()
@@ -261,6 +692,13 @@ bool Engine::running()
 
 void Engine::update()
 {
+	PROFILE_ZONE("Engine::update");
+	m_hitches.beginFrame();
+	// the frame just finished, with the snapshot it drew
+	if (m_overlay.isShown() and m_hitches.getCount() > 0)
+		m_overlay.observe(m_hitches.getLast(), m_snapshots.front().stats);
+	if (m_simulation_failed)
+		std::rethrow_exception(m_simulation_error);
 	if (m_defence_range != nullptr)
 	{
 		float radius = m_defence_range->getRadius();
@@ -269,79 +707,116 @@ void Engine::update()
 		m_defence_range->setPosition(mouse_position.x - radius, mouse_position.y - radius);
 	}
 	serveEvents();
-	static int spawn_counter = 1;
-	if (m_spawning)
+	m_hitches.lap(&FrameRecord::events);
+	if (m_spectator != nullptr)
+		watch();
+	m_fresh = m_snapshots.update();
+	m_hitches.lap(&FrameRecord::snapshot);
+	showForecast();
+	m_hitches.lap(&FrameRecord::forecast);
+	if (m_fresh)
 	{
-		if (--spawn_counter == 0)
+		const Snapshot& snapshot = m_snapshots.front();
+		// a stream goes on with the next game of the batch
+		if (snapshot.over and m_spectator == nullptr)
 		{
-			spawnEntity();
-			spawn_counter = SPAWN_PERIOD;
+			m_game_over = true;
+			m_result = snapshot.result;
 		}
 	}
-	if (--m_attack_counter <= 0)
+}
+
+void Engine::render()
+{
+	PROFILE_ZONE("Engine::render");
+	if (m_paused and m_pause_drawn)
+		return;
+	if (m_behind and not m_fresh and not m_paused)
 	{
-		m_attack_counter = ATTACK_PERIOD;
-		if (not m_defences.empty() and not m_entities.empty())
-			doAttacking();
+		// the simulation needs every cycle it can get, so frames that would only
+		// interpolate the same snapshot again are not drawn
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		m_hitches.lap(&FrameRecord::idle);
+		return;
 	}
-
-	auto it = m_entities.begin();
-	while (it != m_entities.end())
+	const Snapshot& snapshot = m_snapshots.front();
+	if (snapshot.health != m_shown_health)
 	{
-		if (it->move())
-			++it;
-		else
-		{
-			m_health -= m_manager_ref.getEntityRecord(it->getType()).force;
-			if (m_health <= 0)
-			{
-				m_result = Result::Failure;
-				m_game_over = true;
-			}
-			m_health_bar.setString("Health = " + std::to_string(m_health));
-			for (int i = 0; i < m_dividers.size(); ++i)
-			{
-				if (m_dividers[i] == it)
-					++m_dividers[i];
-			}
-			it = m_entities.erase(it);
-		}
+		m_shown_health = snapshot.health;
+		m_health_bar.setString("Health = " + std::to_string(m_shown_health));
 	}
-	if (m_fighting and not m_spawning and m_entities.empty())
+	if (snapshot.money != m_shown_money)
 	{
-		m_fighting = false;
-		spawn_counter = 1;
+		m_shown_money = snapshot.money;
+		m_money_bar.setString("Money = " + std::to_string(m_shown_money));
+	}
+	if (snapshot.fighting != m_start_pressed)
+	{
+		m_start_pressed = snapshot.fighting;
 		m_start_button.toggle();
-		if (m_level.empty())
-		{
-			m_game_over = true;
-			m_result = Result::Victory;
-		}
-		for (int i = 0; i < m_dividers.size(); ++i)
-			m_dividers[i] = m_entities.begin();
-		m_inserter = 1;
 	}
-}
-
-void Engine::render()
-{
+	// entities are drawn between their last two positions, by the part of a tick
+	// that has passed since the snapshot was taken
+	std::chrono::duration<float> since = std::chrono::steady_clock::now() - snapshot.stamp;
+	int speed = m_speed;
+	float alpha = m_paused or speed == 0 ? 1.f : std::clamp(since.count() * m_tick_rate * speed, 0.f, 1.f);
 	m_window_ptr->clear();
-	m_world_ref.drawEverything(*m_window_ptr);
-	for (auto it = m_entities.begin(); it != m_entities.end(); ++it)
-		it->drawYourself(*m_window_ptr);
-	for (auto it = m_defences.begin(); it != m_defences.end(); ++it)
-		(*it)->drawYourself(*m_window_ptr);
-	m_shop_ref.drawYourself(*m_window_ptr);
+	int draws = m_world_ref.drawEverything(*m_window_ptr);
+	m_hitches.lap(&FrameRecord::world);
+	for (const EntityView& view : snapshot.entities)
+	{
+		sf::Sprite& sprite = m_entity_sprites[view.type];
+		sf::Vector2f previous = toFloat(view.previous);
+		sprite.setPosition(previous + alpha * (toFloat(view.position) - previous));
+		m_window_ptr->draw(sprite);
+	}
+	for (const DefenceView& view : snapshot.defences)
+	{
+		sf::Sprite& sprite = m_defence_sprites[static_cast<int>(view.type)];
+		sprite.setPosition(toFloat(view.position));
+		m_window_ptr->draw(sprite);
+	}
+	draws += static_cast<int>(snapshot.entities.size() + snapshot.defences.size());
+	m_hitches.lap(&FrameRecord::sprites);
+	draws += m_shop_ref.drawYourself(*m_window_ptr);
 	m_window_ptr->draw(m_health_bar);
 	m_window_ptr->draw(m_money_bar);
-	m_start_button.drawYourself(*m_window_ptr);
+	draws += 2 + m_start_button.drawYourself(*m_window_ptr);
+	if (m_forecast_ready and not snapshot.fighting)
+	{
+		m_window_ptr->draw(m_forecast_text);
+		++draws;
+	}
 	if (m_defence_range != nullptr)
+	{
 		m_window_ptr->draw(*m_defence_range);
+		++draws;
+	}
+	draws += m_overlay.drawYourself(*m_window_ptr);
+	if (m_paused)
+	{
+		m_window_ptr->draw(m_pause_text);
+		m_pause_drawn = true;
+		++draws;
+	}
+	m_hitches.lap(&FrameRecord::hud);
 	m_window_ptr->display();
+	m_hitches.lap(&FrameRecord::display);
+	m_hitches.note(static_cast<int>(snapshot.entities.size()), static_cast<int>(snapshot.defences.size()), draws,
+		snapshot.stats);
 }
 
 void Engine::finish()
 {
+	stopSimulation();
+	if (m_recorder != nullptr)
+		saveReplay(m_replay_path, m_recorder->finish(*m_simulation));
+	if (m_streamed)
+		getStream()->end(*m_simulation);
+	if (m_exported)
+		getExport()->end();
+	if (m_window_ptr == nullptr)
+		return;
 	sf::Text result, comment;
 	result.setPosition(.1f * WINDOW_WIDTH, .1f * WINDOW_HEIGHT);
 	comment.setPosition(.1f * WINDOW_WIDTH, .1f * WINDOW_HEIGHT + 2.f * TEXT_SIZE);
@@ -367,17 +842,24 @@ void Engine::finish()
 	result.setStyle(sf::Text::Style::Bold);
 	comment.setStyle(sf::Text::Style::Italic);
 	sf::Event event;
+	bool redraw = true;
 	while (m_window_ptr->isOpen())
 	{
-		m_window_ptr->clear();
-		while (m_window_ptr->pollEvent(event))
+		if (redraw)
 		{
-			if (event.type == sf::Event::Closed)
-				m_window_ptr->close();
+			m_window_ptr->clear();
+			m_window_ptr->draw(result);
+			m_window_ptr->draw(comment);
+			m_window_ptr->display();
+			redraw = false;
 		}
-		m_window_ptr->draw(result);
-		m_window_ptr->draw(comment);
-		m_window_ptr->display();
+		// the screen is static, so block instead of redrawing it in a loop
+		if (not m_window_ptr->waitEvent(event))
+			break;
+		if (event.type == sf::Event::Closed)
+			m_window_ptr->close();
+		else if (event.type == sf::Event::Resized or event.type == sf::Event::GainedFocus)
+			redraw = true;
 	}
 	m_window_ptr.reset();
 }
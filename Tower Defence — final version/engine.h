@@ -1,13 +1,26 @@
 #pragma once
 #include "button.h"
 #include "defence.h"
-#include "entity.h"
+#include "export.h"
+#include "forecast.h"
+#include "hitch.h"
 #include "manager.h"
+#include "netplay.h"
+#include "overlay.h"
+#include "replay.h"
+#include "save.h"
 #include "shop.h"
+#include "stream.h"
+#include "simulation.h"
+#include "triple.h"
+#include "workers.h"
 #include "world.h"
-#include <list>
+#include <atomic>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <vector>
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
@@ -16,15 +29,17 @@
 #include <SFML/Window.hpp>
 
 const unsigned int WINDOW_WIDTH = 1200U, WINDOW_HEIGHT = 740, FREQUENCY = 60;
+const int MAX_CATCH_UP = 5; // frames of ticks run at most in one go after a stall
+const int SPEEDS[] = { 1, 2, 4, 16, 0 }; // selected with keys 1 to 5; 0 runs as fast as possible
+const int SPEEDS_NUMBER = sizeof(SPEEDS) / sizeof(SPEEDS[0]);
 const float WORLD_WIDTH = 1000.f, WORLD_HEIGHT = 740.f;
-const int INITIAL_HEALTH = 200, INITIAL_MONEY = 120, SPAWN_PERIOD = 30, ATTACK_PERIOD = 15;;
 const float OUTLINE_THICKNESS = 2.f;
 const sf::Color BUTTON_FILL(0x00, 0xc0, 0xf0), BUTTON_OUTLINE(0x00, 0x60, 0x90),
 	HEALTH_COLOR(0xf0, 0x00, 0x00), MONEY_COLOR(0xff, 0x80, 0x00),
-	RANGE_COLOR(0x80, 0x80, 0xff, 0x80);
-
-enum class Result { Interrupt, Victory, Failure };
+	RANGE_COLOR(0x80, 0x80, 0xff, 0x80), PAUSE_COLOR(0xff, 0xff, 0xff);
 
+// The engine owns the window: it turns input into commands for the simulation,
+// which ticks on its own thread, and draws the latest snapshot the simulation published.
 class Engine
 {
 private:
@@ -35,30 +50,66 @@ private:
 	Manager& m_manager_ref;
 
 	Button m_start_button;
+	bool m_start_pressed = false;
 
-	// level //
+	// simulation //
 
 	Level m_level;
-	bool m_spawning = false;
-	bool m_fighting = false;
-
-	// entities //
-
-	std::list<Entity> m_entities;
+	std::string m_map_name;
+	std::string m_level_name;
+	std::unique_ptr<Simulation> m_simulation;
+	Workers m_workers;
+	TripleBuffer<Snapshot> m_snapshots;
+	std::mutex m_commands_mutex;
+	std::vector<Command> m_commands; // sent by the window thread, taken by the simulation thread
+	std::atomic<bool> m_paused = false;
+	std::exception_ptr m_simulation_error;
+	std::atomic<bool> m_simulation_failed = false;
+	std::jthread m_simulation_thread;
+	unsigned int m_tick_rate = FREQUENCY;
+	unsigned int m_frame_rate = FREQUENCY;
+	std::atomic<int> m_speed = 1;
+	std::atomic<bool> m_behind = false; // the simulation cannot keep up with its speed
+	bool m_fresh = false; // a new snapshot arrived since the last frame
+	std::string m_title;
+	Forecaster m_forecaster;
+	std::string m_replay_path; // the game is recorded there when set
+	std::unique_ptr<Recorder> m_recorder;
+	std::string m_load_path; // the game is resumed from there when set
+	std::atomic<bool> m_save_requested = false; // quicksave, taken by the simulation thread
+	Autosaver m_autosaver;
+	std::unique_ptr<Session> m_session; // co-op with another player when set
+	unsigned short m_host_port = 0; // a co-op game is hosted on it when set
+	std::string m_join_address; // a co-op game is joined there when set, as "address[:port]"
+	bool m_streamed = false; // this game is streamed to viewers
+	bool m_exported = false; // and written to shared memory
+	std::string m_watch_address; // a stream is watched from there when set, as "address[:port]"
+	std::unique_ptr<Spectator> m_spectator;
+
+	// drawing //
+
+	std::vector<sf::Sprite> m_entity_sprites; // per entity type
+	sf::Sprite m_defence_sprites[DEFENCES_NUMBER];
 	sf::Text m_health_bar;
-	int m_health = 0;
+	sf::Text m_money_bar;
+	int m_shown_health = -1;
+	int m_shown_money = -1;
+	sf::Text m_forecast_text; // predicted outcome of the next wave, above the start button
+	std::uint64_t m_shown_forecast = 0;
+	bool m_forecast_ready = false;
+	HitchRecorder m_hitches;
+	Overlay m_overlay; // performance, shown with F3
 
 	// defences //
 
-	sf::Text m_money_bar;
-	int m_money = 0;
 	Shop& m_shop_ref;
-	std::vector<std::unique_ptr<Defence>> m_defences;
-	std::unique_ptr<Defence> m_holder;
+	DefenceType m_selected = DefenceType::None;
 	std::unique_ptr<sf::CircleShape> m_defence_range;
-	std::vector<std::list<Entity>::iterator> m_dividers;
-	int m_inserter = 1;
-	int m_attack_counter = ATTACK_PERIOD;
+
+	// pause //
+
+	sf::Text m_pause_text;
+	bool m_pause_drawn = false;
 
 	// end of game //
 
@@ -68,11 +119,28 @@ private:
 	// -- Methods -- //
 
 	void serveEvents();
+	void serveEvent(const sf::Event& event);
 	void serveLeftButton();
-	void spawnEntity();
-	void doAttacking();
+	void send(const Command& command);
+	void setSpeed(int speed);
+	void showForecast();
+	void prepareSprites();
+	void step();
+	void save(const std::string& name); // on the simulation thread
+	void simulate(std::stop_token stop);
+	void startSimulation();
+	void stopSimulation();
+	std::unique_ptr<Simulation> rebuild(const SavedGame& game, Level& level); // of the level in the save; throws on bad data
+	void adopt(const SavedGame& game, Level& level, std::unique_ptr<Simulation> simulation); // the simulation is stopped
+	void restore(const SavedGame& game); // the simulation is stopped
+	void quickload(); // keeps the game in play when the quicksave cannot be loaded
+	void connect(std::uint64_t& seed); // hosts or joins a co-op game; the guest gets the seed
+	bool decided() const; // the game is over for good
+	bool local() const; // the game runs here, for this player only
+	void watch(); // takes what the stream brought, on the window thread
 
 	Engine();
+	~Engine();
 
 public:
 	static Engine& getInstance()
@@ -81,6 +149,17 @@ public:
 		return instance;
 	}
 
+	// both throw Error(Problem::BadArgument) unless positive; as the rules are counted in
+	// ticks, the tick rate sets how fast the game plays, FREQUENCY being the normal speed
+	void setTickRate(int rate);
+	void setFrameRate(int rate);
+	void setReplayPath(const std::string& path); // games resumed from a save or played in co-op are not recorded
+	void setLoadPath(const std::string& path);
+	void setHostPort(unsigned short port);
+	void setJoinAddress(const std::string& address);
+	void setWatchAddress(const std::string& address);
+	void setHitchBudget(double budget); // milliseconds a frame may take before the last frames are written down
+
 	void prepare();
 	bool running();
 	void update();
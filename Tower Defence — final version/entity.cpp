@@ -1,37 +1,57 @@
 #include "entity.h"
+#include "error.h"
 #include "manager.h"
+#include "profile.h"
 #include "world.h"
 
-Entity::Entity(int type) : m_type(type)
+Entity::Entity(int type, Random& random) : m_type(type)
 {
 	Manager& manager_ref = Manager::getInstance();
 	const EntityRecord& record = manager_ref.getEntityRecord(m_type);
 	m_health = record.health;
-	m_speed = record.speed;
-	m_shift = .5f * record.scale * record.dimensions;
+	m_speed = toFixed(record.speed);
 	m_freeze_count = 0;
 
 	World& world_ref = World::getInstance();
-	int origin = world_ref.getRandomSource();
-	m_position = world_ref.getCoords(origin);
-	m_target = world_ref.getRandomNeighbour(origin);
-	sf::Vector2f there = world_ref.getCoords(m_target);
-	float hypotenuse = std::hypot(there.x - m_position.x, there.y - m_position.y);
-	m_step = m_speed / hypotenuse * (there - m_position);
-	m_steps_count = hypotenuse / m_speed;
-	
-	m_sprite.setTexture(record.texture);
-	m_sprite.setScale(record.scale, record.scale);
-	m_sprite.setPosition(m_position - m_shift);
+	int origin = world_ref.getRandomSource(random);
+	m_edge = world_ref.getRandomEdge(origin, random);
+	m_position = world_ref.getEdge(m_edge).origin;
+	m_previous = m_position;
+	aim();
 }
 
-void Entity::drawYourself(sf::RenderWindow& window)
+Entity::Entity(ByteReader& reader)
 {
-	window.draw(m_sprite);
+	m_type = static_cast<int>(reader.readVarint());
+	const EntityRecord& record = Manager::getInstance().getEntityRecord(m_type);
+	m_speed = toFixed(record.speed);
+	m_health = static_cast<int>(reader.readSigned());
+	m_position.x = static_cast<Fixed>(reader.readSigned());
+	m_position.y = static_cast<Fixed>(reader.readSigned());
+	m_previous.x = m_position.x + static_cast<Fixed>(reader.readSigned());
+	m_previous.y = m_position.y + static_cast<Fixed>(reader.readSigned());
+	m_edge = static_cast<int>(reader.readVarint());
+	m_steps_count = static_cast<int>(reader.readSigned());
+	m_freeze_count = static_cast<int>(reader.readSigned());
+	const Edge& edge = World::getInstance().getEdge(m_edge);
+	// an entity with no steps left would never arrive, and the game would never end
+	if (m_health < 1 or m_health > record.health or m_steps_count < 1 or m_steps_count > edge.stepsCount(m_speed)
+		or m_freeze_count < 0)
+		throw Error(Problem::FileError);
+	m_step = edge.step(m_speed);
 }
 
-bool Entity::move()
+void Entity::aim()
 {
+	const Edge& edge = World::getInstance().getEdge(m_edge);
+	m_step = edge.step(m_speed);
+	m_steps_count = edge.stepsCount(m_speed);
+}
+
+bool Entity::move(Random& random)
+{
+	PROFILE_ZONE("Entity::move");
+	m_previous = m_position;
 	if (m_freeze_count > 0)
 	{
 		--m_freeze_count;
@@ -40,37 +60,63 @@ bool Entity::move()
 	if (--m_steps_count == 0)
 	{
 		World& world_ref = World::getInstance();
-		m_position = world_ref.getCoords(m_target);
-		m_sprite.setPosition(m_position - m_shift);
-		if (world_ref.getType(m_target) == PointType::Tower)
+		const Edge& edge = world_ref.getEdge(m_edge);
+		m_position = world_ref.getCoords(edge.head);
+		if (edge.terminal)
 			return false;
 		else
 		{
-			m_target = world_ref.getRandomNeighbour(m_target);
-			sf::Vector2f there = world_ref.getCoords(m_target);
-			float hypotenuse = std::hypot(there.x - m_position.x, there.y - m_position.y);
-			m_step = m_speed / hypotenuse * (there - m_position);
-			m_steps_count = hypotenuse / m_speed;
+			m_edge = world_ref.getRandomEdge(edge.head, random);
+			aim();
 		}
 	}
 	else
 	{
 		m_position += m_step;
-		m_sprite.move(m_step);
 	}
 	return true;
 }
 
-int Entity::getType()
+int Entity::getType() const
 {
 	return m_type;
 }
 
-sf::Vector2f Entity::getPosition()
+FixedVector Entity::getPosition() const
 {
 	return m_position;
 }
 
+FixedVector Entity::getPreviousPosition() const
+{
+	return m_previous;
+}
+
+int Entity::getHealth() const
+{
+	return m_health;
+}
+
+int Entity::getFreezeCount() const
+{
+	return m_freeze_count;
+}
+
+void Entity::write(ByteWriter& writer) const
+{
+	// the speed and the step follow from the type and the edge;
+	// the previous position is a step away at most, so only the difference is kept
+	writer.writeVarint(m_type);
+	writer.writeSigned(m_health);
+	writer.writeSigned(m_position.x);
+	writer.writeSigned(m_position.y);
+	writer.writeSigned(m_previous.x - m_position.x);
+	writer.writeSigned(m_previous.y - m_position.y);
+	writer.writeVarint(m_edge);
+	writer.writeSigned(m_steps_count);
+	writer.writeSigned(m_freeze_count);
+}
+
 void Entity::takeHit(int force)
 {
 	m_health -= force;
@@ -1,4 +1,7 @@
 #pragma once
+#include "binary.h"
+#include "fixed.h"
+#include "random.h"
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #include <SFML/Network.hpp>
@@ -11,24 +14,29 @@ private:
 
 	int m_type;
 	int m_health;
-	float m_speed;
-	sf::Sprite m_sprite;
-	sf::Vector2f m_shift;
-	sf::Vector2f m_position;
-	sf::Vector2f m_step;
-	int m_target;
+	Fixed m_speed;
+	FixedVector m_position;
+	FixedVector m_previous; // position before the last move
+	FixedVector m_step;
+	int m_edge;
 	int m_steps_count;
 	int m_freeze_count;
 
+	void aim();
+
 public:
 
-	Entity(int type);
+	Entity(int type, Random& random);
+	Entity(ByteReader& reader); // as written by write()
 	
-	void drawYourself(sf::RenderWindow& window);
-	bool move();
+	bool move(Random& random);
 
-	int getType();
-	sf::Vector2f getPosition();
+	int getType() const;
+	FixedVector getPosition() const;
+	FixedVector getPreviousPosition() const;
+	int getHealth() const;
+	int getFreezeCount() const;
+	void write(ByteWriter& writer) const;
 
 	void takeHit(int force);
 	void freeze(int force);
@@ -0,0 +1,157 @@
+#include "environment.h"
+#include "engine.h"
+#include "error.h"
+#include <algorithm>
+
+void Environment::observe()
+{
+	const Simulation& simulation = *m_simulation;
+	Observation& observation = m_observation;
+	if (m_occupancy)
+		std::fill(observation.occupancy.begin(), observation.occupancy.end(), 0);
+	auto mark = [&observation](FixedVector position, int channel)
+	{
+		int column = static_cast<int>(position.x >> FIXED_SHIFT) / OCCUPANCY_CELL;
+		int row = static_cast<int>(position.y >> FIXED_SHIFT) / OCCUPANCY_CELL;
+		if (column < 0 or column >= observation.grid_width or row < 0 or row >= observation.grid_height)
+			return;
+		std::uint8_t& cell = observation.occupancy[(channel * observation.grid_height + row) * observation.grid_width + column];
+		if (cell < 255)
+			++cell;
+	};
+
+	int count = 0;
+	for (const Entity& entity : simulation.getEntities())
+	{
+		FixedVector position = entity.getPosition();
+		if (m_occupancy)
+			mark(position, 0);
+		if (count == ENVIRONMENT_CAPACITY)
+			continue;
+		observation.entity_positions[2 * count] = toFloat(position.x);
+		observation.entity_positions[2 * count + 1] = toFloat(position.y);
+		observation.entity_health[count] = entity.getHealth();
+		observation.entity_types[count] = entity.getType();
+		++count;
+	}
+	observation.entities_count = count;
+
+	count = 0;
+	for (const Defence* defence : simulation.getDefences())
+	{
+		FixedVector position = defence->getPosition();
+		if (m_occupancy)
+			mark(position, 1);
+		if (count == ENVIRONMENT_DEFENCES)
+			continue;
+		observation.defence_positions[2 * count] = toFloat(position.x);
+		observation.defence_positions[2 * count + 1] = toFloat(position.y);
+		observation.defence_types[count] = static_cast<std::int32_t>(defence->getType());
+		++count;
+	}
+	observation.defences_count = count;
+
+	observation.money = simulation.getMoney();
+	observation.health = simulation.getHealth();
+	observation.fighting = simulation.isFighting();
+	observation.over = simulation.isOver();
+	observation.result = simulation.getResult();
+}
+
+Environment::Environment(const Level& level, bool occupancy) :
+	m_level(level),
+	m_occupancy(occupancy)
+{
+	m_observation.entity_positions.resize(2 * ENVIRONMENT_CAPACITY);
+	m_observation.entity_health.resize(ENVIRONMENT_CAPACITY);
+	m_observation.entity_types.resize(ENVIRONMENT_CAPACITY);
+	m_observation.defence_positions.resize(2 * ENVIRONMENT_DEFENCES);
+	m_observation.defence_types.resize(ENVIRONMENT_DEFENCES);
+	if (m_occupancy)
+	{
+		m_observation.grid_width = (static_cast<int>(WORLD_WIDTH) + OCCUPANCY_CELL - 1) / OCCUPANCY_CELL;
+		m_observation.grid_height = (static_cast<int>(WORLD_HEIGHT) + OCCUPANCY_CELL - 1) / OCCUPANCY_CELL;
+		m_observation.occupancy.resize(OCCUPANCY_CHANNELS * m_observation.grid_width * m_observation.grid_height);
+	}
+}
+
+const Observation& Environment::reset(std::uint64_t seed, int money)
+{
+	m_simulation = std::make_unique<Simulation>(m_level, nullptr, seed);
+	m_simulation->setMoney(money);
+	observe();
+	return m_observation;
+}
+
+float Environment::step(const Action& action, int ticks)
+{
+	if (m_simulation == nullptr)
+		throw Error(Problem::NoEpisode);
+	Simulation& simulation = *m_simulation;
+	Command command;
+	switch (action.kind)
+	{
+	case Action::Kind::Start:
+		command.kind = Command::Kind::Start;
+		simulation.execute(command);
+		break;
+	case Action::Kind::Place:
+		command.kind = Command::Kind::Place;
+		command.defence = action.defence;
+		command.position = sf::Vector2i(action.x, action.y);
+		simulation.execute(command);
+		break;
+	default:
+		break;
+	}
+	int health = simulation.getHealth();
+	bool was_over = simulation.isOver();
+	for (int i = 0; i < ticks and not simulation.isOver(); ++i)
+		simulation.tick();
+	float reward = static_cast<float>(std::max(0, simulation.getHealth()) - health);
+	if (not was_over and simulation.isOver() and simulation.getResult() == Result::Victory)
+		reward += simulation.getHealth();
+	observe();
+	return reward;
+}
+
+bool Environment::hasEpisode() const
+{
+	return m_simulation != nullptr;
+}
+
+const Observation& Environment::getObservation() const
+{
+	return m_observation;
+}
+
+const Simulation& Environment::getSimulation() const
+{
+	if (m_simulation == nullptr)
+		throw Error(Problem::NoEpisode);
+	return *m_simulation;
+}
+
+void stepEnvironments(Environment* environments, const Action* actions, float* rewards,
+	int count, int ticks, Workers& workers)
+{
+	struct Batch
+	{
+		Environment* environments;
+		const Action* actions;
+		float* rewards;
+		int ticks;
+	};
+	// checked here, as an error thrown on a worker would not reach the caller
+	for (int i = 0; i < count; ++i)
+	{
+		if (not environments[i].hasEpisode())
+			throw Error(Problem::NoEpisode);
+	}
+	Batch batch{ environments, actions, rewards, ticks };
+	workers.run(count, [](void* context, int task)
+		{
+			Batch& batch = *static_cast<Batch*>(context);
+			batch.rewards[task] = batch.environments[task].step(batch.actions[task], batch.ticks);
+		}, &batch);
+}
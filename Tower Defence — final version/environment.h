@@ -0,0 +1,77 @@
+#pragma once
+#include "simulation.h"
+#include "workers.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+const int ENVIRONMENT_CAPACITY = 1024; // entities observed at most, the rest are left out
+const int ENVIRONMENT_DEFENCES = 256;
+const int OCCUPANCY_CELL = 10; // pixels per side of a grid cell
+const int OCCUPANCY_CHANNELS = 2; // entities per cell, defences per cell
+
+// One decision of an agent: carried out, followed by a number of ticks.
+struct Action
+{
+	enum class Kind { Wait, Start, Place };
+
+	Kind kind = Kind::Wait;
+	DefenceType defence = DefenceType::None;
+	int x = 0;
+	int y = 0;
+};
+
+// State of a game as flat arrays, allocated once with the environment and overwritten
+// by every step, so a training loop reads it in place. Only the first entities_count
+// and defences_count rows are valid; positions are x, y pairs in pixels.
+struct Observation
+{
+	int entities_count = 0;
+	std::vector<float> entity_positions;
+	std::vector<std::int32_t> entity_health;
+	std::vector<std::int32_t> entity_types;
+
+	int defences_count = 0;
+	std::vector<float> defence_positions;
+	std::vector<std::int32_t> defence_types;
+
+	int money = 0;
+	int health = 0;
+	bool fighting = false;
+	bool over = false;
+	Result result = Result::Interrupt;
+
+	// channel-major, row-major counts saturated at 255; empty unless asked for
+	int grid_width = 0;
+	int grid_height = 0;
+	std::vector<std::uint8_t> occupancy;
+};
+
+// Step and reset over one headless game. The reward of a step is the health it cost
+// (zero or negative), plus the health left when it won the game.
+class Environment
+{
+private:
+
+	Level m_level; // a copy, so that the caller's may go
+	std::unique_ptr<Simulation> m_simulation;
+	Observation m_observation;
+	bool m_occupancy;
+
+	void observe();
+
+public:
+
+	Environment(const Level& level, bool occupancy = false);
+
+	const Observation& reset(std::uint64_t seed, int money = INITIAL_MONEY);
+	float step(const Action& action, int ticks = 1); // throws before the first reset
+	bool hasEpisode() const;
+	const Observation& getObservation() const;
+	const Simulation& getSimulation() const; // throws before the first reset
+};
+
+// Steps many environments at once on the crew, one environment per task; all of them
+// have to be reset first.
+void stepEnvironments(Environment* environments, const Action* actions, float* rewards,
+	int count, int ticks, Workers& workers);
@@ -17,6 +17,16 @@ const char* Error::what()
 		return "Error at work with files.";
 	case Problem::NoSources:
 		return "No valid source files.";
+	case Problem::NetworkError:
+		return "Connection with the other player failed.";
+	case Problem::Desync:
+		return "The games of the players differ.";
+	case Problem::SharedMemoryError:
+		return "Shared memory could not be set up.";
+	case Problem::BadArgument:
+		return "A number on the command line is not valid.";
+	case Problem::NoEpisode:
+		return "The environment has not been reset.";
 	default:
 		return "Unspecified problem.";
 	}
@@ -4,7 +4,7 @@
 enum class Problem
 {
 	Unspecified, OutOfRange, Interrupt, FileError,
-	NoSources
+	NoSources, NetworkError, Desync, SharedMemoryError, BadArgument, NoEpisode
 };
 
 class Error : public std::exception
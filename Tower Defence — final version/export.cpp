@@ -0,0 +1,320 @@
+#include "export.h"
+#include "arguments.h"
+#include "error.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::unique_ptr<StateExport> s_export;
+
+	const std::uint32_t FIGHTING = 1, OVER = 2; // flags of a frame; the result in the bits above
+
+	std::uint64_t sealed(std::uint64_t frame)
+	{
+		return 2 * frame + 2;
+	}
+}
+
+// -- shared memory -- //
+
+SharedMemory::~SharedMemory()
+{
+#if defined(_WIN32)
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_handle != nullptr)
+		CloseHandle(reinterpret_cast<HANDLE>(m_handle));
+#else
+	if (m_data != nullptr)
+		munmap(m_data, m_size);
+	if (m_owner)
+		shm_unlink(m_name.c_str());
+#endif
+}
+
+void SharedMemory::create(const std::string& name, std::size_t size)
+{
+	m_size = size;
+#if defined(_WIN32)
+	m_name = "Local\\" + name;
+	HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size), m_name.c_str());
+	if (handle == nullptr)
+		throw Error(Problem::SharedMemoryError);
+	m_handle = handle;
+	m_data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (m_data == nullptr)
+		throw Error(Problem::SharedMemoryError);
+#else
+	m_name = "/" + name;
+	int descriptor = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (descriptor < 0)
+		throw Error(Problem::SharedMemoryError);
+	m_owner = true;
+	bool sized = ftruncate(descriptor, static_cast<off_t>(size)) == 0;
+	void* data = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+	close(descriptor);
+	if (data == MAP_FAILED)
+		throw Error(Problem::SharedMemoryError);
+	m_data = data;
+#endif
+}
+
+void SharedMemory::open(const std::string& name, std::size_t size)
+{
+	m_size = size;
+#if defined(_WIN32)
+	m_name = "Local\\" + name;
+	HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, m_name.c_str());
+	if (handle == nullptr)
+		throw Error(Problem::SharedMemoryError);
+	m_handle = handle;
+	m_data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, size);
+	if (m_data == nullptr)
+		throw Error(Problem::SharedMemoryError);
+#else
+	m_name = "/" + name;
+	int descriptor = shm_open(m_name.c_str(), O_RDONLY, 0);
+	if (descriptor < 0)
+		throw Error(Problem::SharedMemoryError);
+	struct stat status;
+	bool large = fstat(descriptor, &status) == 0 and static_cast<std::size_t>(status.st_size) >= size;
+	void* data = large ? mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+	close(descriptor);
+	if (data == MAP_FAILED)
+		throw Error(Problem::SharedMemoryError);
+	m_data = data;
+#endif
+}
+
+void* SharedMemory::getData() const
+{
+	return m_data;
+}
+
+// -- writer -- //
+
+StateExport::StateExport(const std::string& name)
+{
+	m_memory.create(name, sizeof(ExportHeader));
+	m_header = new (m_memory.getData()) ExportHeader();
+	m_header->slots = EXPORT_SLOTS;
+	m_header->frame_size = sizeof(ExportFrame);
+	m_header->max_entities = EXPORT_ENTITIES;
+	m_header->max_defences = EXPORT_DEFENCES;
+	m_header->fixed_shift = FIXED_SHIFT;
+	m_header->version = EXPORT_VERSION;
+	m_header->open.store(1, std::memory_order_relaxed);
+	// the magic word last, so that a reader never takes a half-made header for a ready one
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = EXPORT_MAGIC;
+}
+
+StateExport::~StateExport()
+{
+	m_header->open.store(0, std::memory_order_release);
+}
+
+bool StateExport::begin()
+{
+	bool following = false;
+	if (not m_following.compare_exchange_strong(following, true))
+		return false;
+	m_header->games.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void StateExport::offer(const Simulation& simulation)
+{
+	// only the followed game writes, so the counters need no more than ordering
+	std::uint64_t number = m_header->written.load(std::memory_order_relaxed);
+	ExportFrame& frame = m_header->frames[number % EXPORT_SLOTS];
+	frame.sequence.store(sealed(number) - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	frame.tick = simulation.getTick();
+	frame.game = m_header->games.load(std::memory_order_relaxed);
+	frame.health = simulation.getHealth();
+	frame.money = simulation.getMoney();
+	frame.leaks = simulation.getLeaks();
+	frame.flags = (simulation.isFighting() ? FIGHTING : 0) | (simulation.isOver() ? OVER : 0)
+		| static_cast<std::uint32_t>(simulation.getResult()) << 2;
+	std::uint32_t total = 0, written = 0;
+	for (const Entity& entity : simulation.getEntities())
+	{
+		++total;
+		if (written == EXPORT_ENTITIES)
+			continue;
+		ExportEntity& record = frame.entities[written++];
+		FixedVector position = entity.getPosition();
+		record.type = entity.getType();
+		record.health = entity.getHealth();
+		record.freeze = entity.getFreezeCount();
+		record.x = position.x;
+		record.y = position.y;
+	}
+	frame.entities_total = total;
+	frame.entities_number = written;
+	written = 0;
+	for (const Defence* defence : simulation.getDefences())
+	{
+		if (written == EXPORT_DEFENCES)
+			break;
+		ExportDefence& record = frame.defences[written++];
+		FixedVector position = defence->getPosition();
+		record.type = static_cast<std::int32_t>(defence->getType());
+		record.counter = defence->getCounter();
+		record.x = position.x;
+		record.y = position.y;
+	}
+	frame.defences_number = written;
+
+	frame.sequence.store(sealed(number), std::memory_order_release);
+	m_header->written.store(number + 1, std::memory_order_release);
+}
+
+void StateExport::end()
+{
+	m_following = false;
+}
+
+void openExport(const std::string& name)
+{
+	s_export = std::make_unique<StateExport>(name);
+}
+
+StateExport* getExport()
+{
+	return s_export.get();
+}
+
+// -- reader -- //
+
+void StateReader::open(const std::string& name)
+{
+	m_memory.open(name, sizeof(ExportHeader));
+	m_header = static_cast<const ExportHeader*>(m_memory.getData());
+	if (m_header->magic != EXPORT_MAGIC)
+		throw Error(Problem::SharedMemoryError);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (m_header->version != EXPORT_VERSION or m_header->slots != EXPORT_SLOTS
+		or m_header->frame_size != sizeof(ExportFrame))
+		throw Error(Problem::SharedMemoryError);
+}
+
+std::uint64_t StateReader::getWritten() const
+{
+	return m_header->written.load(std::memory_order_acquire);
+}
+
+bool StateReader::isOpen() const
+{
+	return m_header->open.load(std::memory_order_acquire) != 0;
+}
+
+const ExportFrame* StateReader::find(std::uint64_t frame) const
+{
+	const ExportFrame* view = &m_header->frames[frame % EXPORT_SLOTS];
+	if (view->sequence.load(std::memory_order_acquire) != sealed(frame))
+		return nullptr;
+	return view;
+}
+
+bool StateReader::isIntact(const ExportFrame* view, std::uint64_t frame) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return view->sequence.load(std::memory_order_relaxed) == sealed(frame);
+}
+
+// -- monitor -- //
+
+int runMonitor(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: monitor <export name> [<seconds>]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		using Clock = std::chrono::steady_clock;
+		StateReader reader;
+		reader.open(argv[2]);
+		Clock::time_point start = Clock::now(), report = start + std::chrono::seconds(1);
+		Clock::duration limit = argc > 3 ? std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(parseDouble(argv[3]))) : Clock::duration::max();
+
+		// reads every frame it can, in order, and reports once a second what it saw
+		std::uint64_t next = reader.getWritten(), read = 0, dropped = 0, most = 0;
+		std::uint64_t tick = 0, game = 0;
+		std::uint32_t entities = 0, defences = 0;
+		int health = 0, money = 0;
+		bool open = true;
+		while (open and Clock::now() - start < limit)
+		{
+			open = reader.isOpen();
+			std::uint64_t written = reader.getWritten();
+			if (written - next > EXPORT_SLOTS)
+			{
+				dropped += written - next - EXPORT_SLOTS;
+				next = written - EXPORT_SLOTS;
+			}
+			for (; next < written; ++next)
+			{
+				const ExportFrame* view = reader.find(next);
+				if (view == nullptr)
+				{
+					++dropped;
+					continue;
+				}
+				std::uint64_t frame_tick = view->tick, frame_game = view->game;
+				std::uint32_t frame_entities = view->entities_total, frame_defences = view->defences_number;
+				int frame_health = view->health, frame_money = view->money;
+				if (not reader.isIntact(view, next))
+				{
+					++dropped;
+					continue;
+				}
+				++read;
+				tick = frame_tick;
+				game = frame_game;
+				entities = frame_entities;
+				defences = frame_defences;
+				health = frame_health;
+				money = frame_money;
+				most = std::max<std::uint64_t>(most, entities);
+			}
+			if (Clock::now() >= report or not open)
+			{
+				std::cout << "game " << game << ", tick " << tick << ": " << entities << " entities, "
+					<< defences << " defences, health " << health << ", money " << money << "; "
+					<< read << " frames read, " << dropped << " dropped" << std::endl;
+				report += std::chrono::seconds(1);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::cout << "At most " << most << " entities at once." << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "fixed.h"
+#include "simulation.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// State export: every tick of a game is written to a ring of EXPORT_SLOTS frames in
+// shared memory, where local tools (plotters, heat maps, checkers) read it in place.
+// The layout below is all of the format: plain integers, positions in the simulation's
+// fixed point, so a reader in any language only has to map the memory.
+// The writer never waits. Frame n goes to slot n % EXPORT_SLOTS; the slot's sequence is
+// odd while it is written and 2n + 2 once frame n is whole. A reader notes the sequence,
+// reads, and checks the sequence again; if it changed, the writer lapped it and the frame
+// is dropped. A reader thus skips frames when it is slow, and never slows the game.
+// The memory is named "Local\<name>" on Windows and "/<name>" on other systems.
+// The game and the tools export with --export <name>; monitor <name> follows an export.
+
+const std::uint32_t EXPORT_MAGIC = 0x58534454; // "TDSX"
+const std::uint32_t EXPORT_VERSION = 1;
+const std::uint32_t EXPORT_SLOTS = 8;
+const std::uint32_t EXPORT_ENTITIES = 8192; // more are counted, but not written
+const std::uint32_t EXPORT_DEFENCES = 1024;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+struct ExportEntity
+{
+	std::int32_t type;
+	std::int32_t health;
+	std::int32_t freeze; // ticks frozen for
+	Fixed x;
+	Fixed y;
+};
+
+struct ExportDefence
+{
+	std::int32_t type;
+	std::int32_t counter; // ticks to the next attack
+	Fixed x;
+	Fixed y;
+};
+
+struct ExportFrame
+{
+	std::atomic<std::uint64_t> sequence;
+	std::uint64_t tick;
+	std::uint64_t game; // the number of the game, from 1
+	std::int32_t health;
+	std::int32_t money;
+	std::int32_t leaks;
+	std::uint32_t flags; // 1 fighting, 2 over, the result from bit 2 on
+	std::uint32_t entities_total;
+	std::uint32_t entities_number; // written, at most EXPORT_ENTITIES
+	std::uint32_t defences_number;
+	std::uint32_t reserved;
+	ExportEntity entities[EXPORT_ENTITIES];
+	ExportDefence defences[EXPORT_DEFENCES];
+};
+
+struct ExportHeader
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t slots;
+	std::uint32_t frame_size; // bytes of an ExportFrame
+	std::uint32_t max_entities;
+	std::uint32_t max_defences;
+	std::uint32_t fixed_shift;
+	std::atomic<std::uint32_t> open; // 0 once the writer is gone
+	std::atomic<std::uint64_t> written; // frames, the last one in slot (written - 1) % slots
+	std::atomic<std::uint64_t> games;
+	ExportFrame frames[EXPORT_SLOTS];
+};
+
+// A named block of memory shared between processes.
+class SharedMemory
+{
+private:
+
+	std::string m_name;
+	void* m_handle = nullptr; // of the mapping, on Windows
+	void* m_data = nullptr;
+	std::size_t m_size = 0;
+	bool m_owner = false;
+
+public:
+
+	SharedMemory() = default;
+	~SharedMemory();
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	// both throw Error(Problem::SharedMemoryError)
+	void create(const std::string& name, std::size_t size);
+	void open(const std::string& name, std::size_t size);
+	void* getData() const;
+};
+
+// The writing end. Like a stream, it follows one game at a time.
+class StateExport
+{
+private:
+
+	SharedMemory m_memory;
+	ExportHeader* m_header = nullptr;
+	std::atomic<bool> m_following = false;
+
+public:
+
+	StateExport(const std::string& name); // throws Error(Problem::SharedMemoryError)
+	~StateExport();
+	StateExport(const StateExport&) = delete;
+	StateExport& operator=(const StateExport&) = delete;
+
+	bool begin(); // true when the calling game is the one followed
+	void offer(const Simulation& simulation); // after every tick of the followed game
+	void end();
+};
+
+void openExport(const std::string& name); // for the rest of the process
+StateExport* getExport(); // nullptr when not exporting
+
+// The reading end; frames are read where they lie, without copying.
+class StateReader
+{
+private:
+
+	SharedMemory m_memory;
+	const ExportHeader* m_header = nullptr;
+
+public:
+
+	void open(const std::string& name); // throws Error(Problem::SharedMemoryError), also on a wrong format
+	std::uint64_t getWritten() const;
+	bool isOpen() const; // the writer still runs
+	const ExportFrame* find(std::uint64_t frame) const; // nullptr when it is not there (yet or any more)
+	bool isIntact(const ExportFrame* view, std::uint64_t frame) const; // after reading it: was it not overwritten meanwhile
+};
+
+int runMonitor(int argc, char* argv[]);
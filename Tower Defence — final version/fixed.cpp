@@ -0,0 +1,75 @@
+#include "fixed.h"
+#include <cmath>
+
+FixedVector::FixedVector(Fixed new_x, Fixed new_y) : x(new_x), y(new_y)
+{
+}
+
+bool operator==(const FixedVector& lhs, const FixedVector& rhs)
+{
+	return lhs.x == rhs.x and lhs.y == rhs.y;
+}
+
+FixedVector operator+(const FixedVector& lhs, const FixedVector& rhs)
+{
+	return FixedVector(lhs.x + rhs.x, lhs.y + rhs.y);
+}
+
+FixedVector operator-(const FixedVector& lhs, const FixedVector& rhs)
+{
+	return FixedVector(lhs.x - rhs.x, lhs.y - rhs.y);
+}
+
+FixedVector& operator+=(FixedVector& lhs, const FixedVector& rhs)
+{
+	lhs.x += rhs.x;
+	lhs.y += rhs.y;
+	return lhs;
+}
+
+Fixed toFixed(float value)
+{
+	// scaling by a power of two is exact, so this rounding is the only one
+	return static_cast<Fixed>(std::lround(value * FIXED_ONE));
+}
+
+FixedVector toFixed(const sf::Vector2f& vector)
+{
+	return FixedVector(toFixed(vector.x), toFixed(vector.y));
+}
+
+float toFloat(Fixed value)
+{
+	return static_cast<float>(value) / FIXED_ONE;
+}
+
+sf::Vector2f toFloat(const FixedVector& vector)
+{
+	return sf::Vector2f(toFloat(vector.x), toFloat(vector.y));
+}
+
+std::uint64_t squaredLength(const FixedVector& vector)
+{
+	std::int64_t x = vector.x, y = vector.y;
+	return static_cast<std::uint64_t>(x * x) + static_cast<std::uint64_t>(y * y);
+}
+
+std::uint32_t squareRoot(std::uint64_t value)
+{
+	// digit-by-digit method: floor of the exact root, no floating point involved
+	std::uint64_t root = 0, bit = 1ULL << 62;
+	while (bit > value)
+		bit >>= 2;
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return static_cast<std::uint32_t>(root);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <SFML/System/Vector2.hpp>
+
+// Q15.16 fixed-point numbers used for the simulation state. Only integer operations
+// are applied to them, so a game evolves identically on every compiler and machine;
+// floats are converted once, when data is loaded, and back only for drawing.
+
+using Fixed = std::int32_t;
+
+const int FIXED_SHIFT = 16;
+const Fixed FIXED_ONE = 1 << FIXED_SHIFT;
+
+struct FixedVector
+{
+	Fixed x = 0;
+	Fixed y = 0;
+
+	FixedVector() = default;
+	FixedVector(Fixed new_x, Fixed new_y);
+};
+
+bool operator==(const FixedVector& lhs, const FixedVector& rhs);
+FixedVector operator+(const FixedVector& lhs, const FixedVector& rhs);
+FixedVector operator-(const FixedVector& lhs, const FixedVector& rhs);
+FixedVector& operator+=(FixedVector& lhs, const FixedVector& rhs);
+
+Fixed toFixed(float value);
+FixedVector toFixed(const sf::Vector2f& vector);
+float toFloat(Fixed value);
+sf::Vector2f toFloat(const FixedVector& vector);
+
+std::uint64_t squaredLength(const FixedVector& vector);
+std::uint32_t squareRoot(std::uint64_t value);
@@ -0,0 +1,97 @@
+#include "forecast.h"
+#include "profile.h"
+#include <algorithm>
+#include <chrono>
+
+void Forecaster::work(std::stop_token stop)
+{
+	PROFILE_THREAD("forecast");
+	while (not stop.stop_requested())
+	{
+		std::unique_ptr<Simulation> state;
+		std::uint64_t request = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (not m_wake.wait(lock, stop, [this]() { return m_pending != nullptr; }))
+				return;
+			state = std::move(m_pending);
+			request = m_requests;
+		}
+		forecast(*state, request);
+	}
+}
+
+void Forecaster::forecast(const Simulation& state, std::uint64_t request)
+{
+	Forecast forecast;
+	forecast.request = request;
+	std::uint64_t ticks = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int seed = 1; seed <= FORECAST_SEEDS; ++seed)
+	{
+		Simulation game(state);
+		game.reseed(seed);
+		Command command;
+		command.kind = Command::Kind::Start;
+		game.execute(command);
+		while (game.isFighting() and not game.isOver())
+		{
+			if (m_latest.load(std::memory_order_relaxed) != request)
+				return;
+			game.tick();
+			++ticks;
+		}
+		int health_loss = state.getHealth() - std::max(0, game.getHealth());
+		forecast.leaks += game.getLeaks() - state.getLeaks();
+		forecast.health_loss += health_loss;
+		forecast.worst_health_loss = std::max(forecast.worst_health_loss, health_loss);
+		if (game.getResult() == Result::Failure)
+			++forecast.failures;
+		++forecast.runs;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	forecast.leaks /= forecast.runs;
+	forecast.health_loss /= forecast.runs;
+	if (elapsed.count() > 0.)
+		forecast.ticks_per_second = ticks / elapsed.count();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (request == m_requests)
+		m_forecast = forecast;
+}
+
+Forecaster::Forecaster() :
+	m_thread([this](std::stop_token stop) { work(stop); })
+{
+}
+
+void Forecaster::request(std::unique_ptr<Simulation> state)
+{
+	// the copy plays alone; the crew of workers belongs to the real game
+	state->setWorkers(nullptr);
+	std::unique_ptr<Simulation> replaced;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		replaced = std::move(m_pending);
+		m_pending = std::move(state);
+		m_latest = ++m_requests;
+	}
+	m_wake.notify_one();
+}
+
+void Forecaster::cancel()
+{
+	std::unique_ptr<Simulation> dropped;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	dropped = std::move(m_pending);
+	m_latest = ++m_requests;
+}
+
+bool Forecaster::latest(Forecast& forecast)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_forecast.request != m_requests or m_forecast.runs == 0)
+		return false;
+	forecast = m_forecast;
+	return true;
+}
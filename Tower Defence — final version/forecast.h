@@ -0,0 +1,50 @@
+#pragma once
+#include "simulation.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+const int FORECAST_SEEDS = 8;
+
+// Outcome of the next wave, averaged over seeded runs of copies of the game.
+struct Forecast
+{
+	std::uint64_t request = 0; // the state it was made for
+	int runs = 0;
+	float leaks = 0.f;
+	float health_loss = 0.f;
+	int worst_health_loss = 0;
+	int failures = 0; // runs in which the game was lost
+	double ticks_per_second = 0.; // simulation throughput while forecasting
+};
+
+// Plays the next wave of a copied game once per seed on its own thread, while the
+// player is still placing defences. A newer request abandons the runs of an older one.
+class Forecaster
+{
+private:
+
+	std::mutex m_mutex;
+	std::condition_variable_any m_wake;
+	std::unique_ptr<Simulation> m_pending;
+	std::uint64_t m_requests = 0;
+	std::atomic<std::uint64_t> m_latest = 0; // checked by running games to give up early
+	Forecast m_forecast;
+	std::jthread m_thread; // last, so that it stops before the rest is destroyed
+
+	void work(std::stop_token stop);
+	void forecast(const Simulation& state, std::uint64_t request);
+
+public:
+
+	Forecaster();
+	Forecaster(const Forecaster&) = delete;
+	Forecaster& operator=(const Forecaster&) = delete;
+
+	void request(std::unique_ptr<Simulation> state);
+	void cancel();
+	bool latest(Forecast& forecast);
+};
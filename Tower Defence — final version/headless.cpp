@@ -0,0 +1,118 @@
+#include "headless.h"
+#include "engine.h"
+#include "error.h"
+#include "export.h"
+#include "stream.h"
+#include "world.h"
+
+void loadHeadless()
+{
+	Manager& manager_ref = Manager::getInstance();
+	World::getInstance().setDimensions(WORLD_WIDTH, WORLD_HEIGHT);
+	manager_ref.checkMaps();
+	manager_ref.readEntitiesData();
+	manager_ref.checkLevels();
+	manager_ref.readDefencesData();
+}
+
+int layoutCost(const Layout& layout)
+{
+	Manager& manager_ref = Manager::getInstance();
+	int cost = 0;
+	for (const Placement& placement : layout)
+		cost += manager_ref.getDefenceRecord(placement.type).cost;
+	return cost;
+}
+
+int referenceIndex(const std::string& name)
+{
+	for (int i = 0; i < REFERENCES_NUMBER; ++i)
+	{
+		if (REFERENCE_NAMES[i] == name)
+			return i;
+	}
+	throw Error(Problem::OutOfRange);
+}
+
+// Fills the budget with defences of every type in turn, put on the spots in turn.
+static Layout fillSpots(const std::vector<sf::Vector2i>& spots, int budget)
+{
+	Manager& manager_ref = Manager::getInstance();
+	Layout layout;
+	if (spots.empty())
+		return layout;
+	int type = 0;
+	for (int spot = 0; ; ++spot)
+	{
+		int tried = 0;
+		while (tried < DEFENCES_NUMBER and manager_ref.getDefenceRecord(static_cast<DefenceType>(type)).cost > budget)
+		{
+			type = (type + 1) % DEFENCES_NUMBER;
+			++tried;
+		}
+		if (tried == DEFENCES_NUMBER)
+			return layout;
+		budget -= manager_ref.getDefenceRecord(static_cast<DefenceType>(type)).cost;
+		layout.push_back({ static_cast<DefenceType>(type), spots[spot % spots.size()] });
+		type = (type + 1) % DEFENCES_NUMBER;
+	}
+}
+
+static sf::Vector2i pointOnEdge(const Edge& edge, int numerator, int denominator)
+{
+	return sf::Vector2i(static_cast<int>(toFloat(edge.origin.x + edge.difference.x / denominator * numerator)),
+		static_cast<int>(toFloat(edge.origin.y + edge.difference.y / denominator * numerator)));
+}
+
+std::vector<Layout> referenceLayouts(int budget)
+{
+	World& world_ref = World::getInstance();
+	std::vector<sf::Vector2i> exits, middles;
+	for (int i = 0; i < world_ref.getEdgesNumber(); ++i)
+	{
+		const Edge& edge = world_ref.getEdge(i);
+		if (edge.terminal)
+			exits.push_back(pointOnEdge(edge, 3, 4));
+		middles.push_back(pointOnEdge(edge, 1, 2));
+	}
+	return { Layout(), fillSpots(exits, budget), fillSpots(middles, budget) };
+}
+
+Outcome playHeadless(const Level& level, const Layout& layout, int money, std::uint64_t seed)
+{
+	Simulation simulation(level, nullptr, seed);
+	simulation.setMoney(money);
+	Command command;
+	command.kind = Command::Kind::Place;
+	for (const Placement& placement : layout)
+	{
+		command.defence = placement.type;
+		command.position = placement.position;
+		simulation.execute(command);
+	}
+	command.kind = Command::Kind::Start;
+	Broadcaster* stream = getStream();
+	bool streamed = stream != nullptr and stream->begin();
+	StateExport* state_export = getExport();
+	bool exported = state_export != nullptr and state_export->begin();
+	while (not simulation.isOver())
+	{
+		if (not simulation.isFighting())
+			simulation.execute(command);
+		simulation.tick();
+		if (streamed)
+			stream->offer(simulation);
+		if (exported)
+			state_export->offer(simulation);
+	}
+	if (streamed)
+		stream->end(simulation);
+	if (exported)
+		state_export->end();
+	Outcome outcome;
+	outcome.result = simulation.getResult();
+	outcome.health = simulation.getHealth();
+	outcome.leaks = simulation.getLeaks();
+	outcome.ticks = simulation.getTick();
+	return outcome;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "defence.h"
+#include "manager.h"
+#include "simulation.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <SFML/System.hpp>
+
+// Games without a window, for the batch tools: a layout of defences is bought before
+// the first wave, then every wave is started as soon as the previous one is over.
+
+struct Placement
+{
+	DefenceType type = DefenceType::None;
+	sf::Vector2i position;
+};
+
+using Layout = std::vector<Placement>;
+
+// The same strategies on every map: no defences at all, defences guarding the last
+// stretches before the towers, and defences spread over the middles of all paths.
+const std::string REFERENCE_NAMES[]{ "none", "exits", "spread" };
+const int REFERENCES_NUMBER = 3;
+
+struct Outcome
+{
+	Result result = Result::Interrupt;
+	int health = 0;
+	int leaks = 0;
+	std::uint64_t ticks = 0;
+};
+
+void loadHeadless(); // everything but a map, which is loaded by name afterwards
+int layoutCost(const Layout& layout);
+int referenceIndex(const std::string& name);
+std::vector<Layout> referenceLayouts(int budget); // for the loaded map, in the order of the names
+Outcome playHeadless(const Level& level, const Layout& layout, int money, std::uint64_t seed);
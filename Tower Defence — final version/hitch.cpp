@@ -0,0 +1,166 @@
+#include "hitch.h"
+#include "allocations.h"
+#include <fstream>
+
+namespace
+{
+	float milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<float, std::milli>(duration).count();
+	}
+
+	void writeFrames(const std::filesystem::path& path, const std::vector<FrameRecord>& frames)
+	{
+		// a failed dump is not worth stopping the game for
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+		std::ofstream file(path);
+		if (not file)
+			return;
+		file << "frame\tstart\ttotal\tevents\tsnapshot\tforecast\tidle\tworld\tsprites\thud\tdisplay"
+			"\tticks\ttick time\tworst tick\tspawn\tattack\tmove\trange tests\thits"
+			"\tentities\tdefences\tdraw calls\tallocations\tallocated\n";
+		for (const FrameRecord& record : frames)
+		{
+			file << record.frame << '\t' << record.start << '\t' << record.total << '\t' << record.events
+				<< '\t' << record.snapshot << '\t' << record.forecast << '\t' << record.idle << '\t' << record.world
+				<< '\t' << record.sprites << '\t' << record.hud << '\t' << record.display
+				<< '\t' << record.ticks << '\t' << record.tick_time << '\t' << record.worst_tick
+				<< '\t' << record.spawn_time << '\t' << record.attack_time << '\t' << record.move_time
+				<< '\t' << record.range_tests << '\t' << record.hits
+				<< '\t' << record.entities << '\t' << record.defences << '\t' << record.draw_calls
+				<< '\t' << record.allocations << '\t' << record.allocated << '\n';
+		}
+	}
+}
+
+std::filesystem::path hitchPath(int number)
+{
+	return std::filesystem::path(HITCHES_DIR) / ("hitch-" + std::to_string(number) + HITCH_EXTENSION);
+}
+
+HitchRecorder::HitchRecorder() :
+	m_origin(Clock::now()),
+	m_thread([this](std::stop_token stop) { work(stop); })
+{
+}
+
+void HitchRecorder::setBudget(double budget)
+{
+	m_budget = budget;
+}
+
+void HitchRecorder::beginFrame()
+{
+	Clock::time_point now = Clock::now();
+	if (m_started)
+	{
+		m_current.total = milliseconds(now - m_frame_start);
+		m_current.ticks = m_ticks.exchange(0, std::memory_order_relaxed);
+		m_current.tick_time = m_tick_time.exchange(0, std::memory_order_relaxed) * 1e-6f;
+		m_current.worst_tick = m_worst_tick.exchange(0, std::memory_order_relaxed) * 1e-6f;
+		std::uint64_t allocations = countAllocations(), allocated = countAllocatedBytes();
+		m_current.allocations = allocations - m_allocations;
+		m_current.allocated = allocated - m_allocated;
+		m_allocations = allocations;
+		m_allocated = allocated;
+		m_frames[m_count % HITCH_FRAMES] = m_current;
+		++m_count;
+		if (m_budget > 0. and m_current.total > m_budget and m_dumps < HITCH_DUMPS and m_count >= m_quiet_until)
+		{
+			dump();
+			++m_dumps;
+			m_quiet_until = m_count + HITCH_FRAMES;
+		}
+	}
+	else
+	{
+		m_allocations = countAllocations();
+		m_allocated = countAllocatedBytes();
+		m_started = true;
+	}
+	m_current = FrameRecord();
+	m_current.frame = m_count;
+	m_current.start = std::chrono::duration<double, std::milli>(now - m_origin).count();
+	m_frame_start = m_lap_start = now;
+}
+
+void HitchRecorder::resume()
+{
+	m_frame_start = m_lap_start = Clock::now();
+}
+
+void HitchRecorder::lap(float FrameRecord::* phase)
+{
+	Clock::time_point now = Clock::now();
+	m_current.*phase += milliseconds(now - m_lap_start);
+	m_lap_start = now;
+}
+
+void HitchRecorder::note(int entities, int defences, int draw_calls, const SimulationStats& stats)
+{
+	m_current.entities = entities;
+	m_current.defences = defences;
+	m_current.draw_calls = draw_calls;
+	// the statistics start over with every new simulation, as after loading a quicksave
+	if (stats.ticks < m_stats.ticks)
+		m_stats = SimulationStats();
+	m_current.spawn_time = (stats.spawn_time - m_stats.spawn_time) * 1e-6f;
+	m_current.attack_time = (stats.attack_time - m_stats.attack_time) * 1e-6f;
+	m_current.move_time = (stats.move_time - m_stats.move_time) * 1e-6f;
+	m_current.range_tests = stats.range_tests - m_stats.range_tests;
+	m_current.hits = stats.hits - m_stats.hits;
+	m_stats = stats;
+}
+
+void HitchRecorder::recordTick(Clock::duration duration)
+{
+	std::int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	m_ticks.fetch_add(1, std::memory_order_relaxed);
+	m_tick_time.fetch_add(nanoseconds, std::memory_order_relaxed);
+	// only this thread raises it, and the window thread only resets it
+	if (nanoseconds > m_worst_tick.load(std::memory_order_relaxed))
+		m_worst_tick.store(nanoseconds, std::memory_order_relaxed);
+}
+
+const FrameRecord& HitchRecorder::getLast() const
+{
+	return m_frames[(m_count + HITCH_FRAMES - 1) % HITCH_FRAMES];
+}
+
+std::uint64_t HitchRecorder::getCount() const
+{
+	return m_count;
+}
+
+void HitchRecorder::dump()
+{
+	// the copy is all the window thread does; the writing is left to the thread of the recorder
+	std::vector<FrameRecord> frames;
+	std::uint64_t first = m_count > HITCH_FRAMES ? m_count - HITCH_FRAMES : 0;
+	frames.reserve(static_cast<std::size_t>(m_count - first));
+	for (std::uint64_t i = first; i < m_count; ++i)
+		frames.push_back(m_frames[i % HITCH_FRAMES]);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.emplace_back(hitchPath(m_dumps + 1), std::move(frames));
+	}
+	m_wake.notify_one();
+}
+
+void HitchRecorder::work(std::stop_token stop)
+{
+	// pending dumps are written before exit
+	while (true)
+	{
+		std::vector<std::pair<std::filesystem::path, std::vector<FrameRecord>>> dumps;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (not m_wake.wait(lock, stop, [this]() { return not m_pending.empty(); }))
+				return;
+			dumps.swap(m_pending);
+		}
+		for (const auto& [path, frames] : dumps)
+			writeFrames(path, frames);
+	}
+}
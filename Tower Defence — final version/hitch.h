@@ -0,0 +1,110 @@
+#pragma once
+#include "simulation.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Flight recorder for hitches: the window thread notes how long each part of every frame
+// took, with the ticks the simulation ran meanwhile and how their phases went, the counts
+// of entities, defences, draw calls and allocations. The last HITCH_FRAMES frames are kept,
+// and when a frame takes longer than the budget, a copy of them is handed to a thread of
+// the recorder, which writes it to HITCHES_DIR as a table, the slow frame last. After a
+// dump, the next one waits for a whole new history, and a game writes HITCH_DUMPS files at
+// most. Blocking waits, for the player during a pause or for a
+// quicksave to load, are no hitches, so the frame clock starts again after them.
+// The budget is set with --hitch <ms>; 0 turns the recorder off.
+
+const int HITCH_FRAMES = 300; // five seconds at 60 frames a second
+const double HITCH_BUDGET = 50.; // milliseconds
+const int HITCH_DUMPS = 10;
+const std::string HITCHES_DIR = "Hitches", HITCH_EXTENSION = ".tsv";
+
+// milliseconds, all of them
+struct FrameRecord
+{
+	std::uint64_t frame = 0;
+	double start = 0.; // since the recorder was made
+	float total = 0.f; // from the start of this frame to the start of the next one
+	float events = 0.f;
+	float snapshot = 0.f; // taking the latest state, or what the stream brought
+	float forecast = 0.f;
+	float idle = 0.f; // frames left out while the simulation catches up
+	float world = 0.f;
+	float sprites = 0.f;
+	float hud = 0.f; // the shop, bars and buttons
+	float display = 0.f;
+	int ticks = 0; // run by the simulation thread during the frame
+	float tick_time = 0.f;
+	float worst_tick = 0.f;
+	float spawn_time = 0.f; // the phases of the ticks between this frame's snapshot and the last one's
+	float attack_time = 0.f;
+	float move_time = 0.f;
+	std::uint64_t range_tests = 0;
+	std::uint64_t hits = 0;
+	int entities = 0;
+	int defences = 0;
+	int draw_calls = 0;
+	std::uint64_t allocations = 0; // of the whole process
+	std::uint64_t allocated = 0; // bytes
+};
+
+class HitchRecorder
+{
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	std::array<FrameRecord, HITCH_FRAMES> m_frames; // a ring
+	std::uint64_t m_count = 0; // frames finished
+	FrameRecord m_current;
+	bool m_started = false;
+	Clock::time_point m_origin;
+	Clock::time_point m_frame_start;
+	Clock::time_point m_lap_start;
+	std::uint64_t m_allocations = 0;
+	std::uint64_t m_allocated = 0;
+	double m_budget = HITCH_BUDGET;
+	int m_dumps = 0;
+	std::uint64_t m_quiet_until = 0; // no dump before this many frames are finished
+	SimulationStats m_stats; // of the snapshot drawn in the frame before
+
+	// from the simulation thread
+	std::atomic<int> m_ticks = 0;
+	std::atomic<std::int64_t> m_tick_time = 0; // nanoseconds
+	std::atomic<std::int64_t> m_worst_tick = 0;
+
+	// the writer
+	std::mutex m_mutex;
+	std::condition_variable_any m_wake;
+	std::vector<std::pair<std::filesystem::path, std::vector<FrameRecord>>> m_pending;
+	std::jthread m_thread; // last, so that it stops before the rest is destroyed
+
+	void dump();
+	void work(std::stop_token stop);
+
+public:
+
+	HitchRecorder();
+	HitchRecorder(const HitchRecorder&) = delete;
+	HitchRecorder& operator=(const HitchRecorder&) = delete;
+
+	void setBudget(double budget); // milliseconds, 0 for none
+	void beginFrame(); // finishes the frame before
+	void resume(); // after a blocking wait, which is left out of the frame
+	void lap(float FrameRecord::* phase); // the time since the last lap or the frame start goes to the phase
+	void note(int entities, int defences, int draw_calls, const SimulationStats& stats); // of the snapshot drawn
+	void recordTick(Clock::duration duration); // on the simulation thread
+
+	const FrameRecord& getLast() const; // the frame finished last
+	std::uint64_t getCount() const;
+};
+
+std::filesystem::path hitchPath(int number);
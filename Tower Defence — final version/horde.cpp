@@ -0,0 +1,101 @@
+#include "horde.h"
+#include "manager.h"
+#include "world.h"
+
+const Horde::Pace& Horde::pace(const CompactEntity& entity) const
+{
+	return m_paces[entity.edge * m_types_number + entity.type];
+}
+
+Horde::Horde(int types_number, std::uint64_t seed) : m_types_number(types_number), m_random(seed)
+{
+	Manager& manager_ref = Manager::getInstance();
+	World& world_ref = World::getInstance();
+	std::vector<Fixed> speeds;
+	for (int type = 0; type < m_types_number; ++type)
+	{
+		const EntityRecord& record = manager_ref.getEntityRecord(type);
+		speeds.push_back(toFixed(record.speed));
+		m_healths.push_back(record.health);
+		m_forces.push_back(record.force);
+	}
+	for (int i = 0; i < world_ref.getEdgesNumber(); ++i)
+	{
+		const Edge& edge = world_ref.getEdge(i);
+		for (int type = 0; type < m_types_number; ++type)
+		{
+			Pace pace;
+			pace.step = edge.step(speeds[type]);
+			pace.count = edge.stepsCount(speeds[type]);
+			m_paces.push_back(pace);
+		}
+	}
+}
+
+void Horde::reserve(std::size_t count)
+{
+	m_entities.reserve(count);
+}
+
+void Horde::spawn(int type)
+{
+	World& world_ref = World::getInstance();
+	CompactEntity entity;
+	entity.edge = world_ref.getRandomEdge(world_ref.getRandomSource(m_random), m_random);
+	entity.health = m_healths.at(type);
+	entity.type = static_cast<std::uint16_t>(type);
+	m_entities.push_back(entity);
+}
+
+int Horde::move()
+{
+	// the same rules as Entity::move; arrivals are swapped out, so the order is not kept
+	World& world_ref = World::getInstance();
+	int damage = 0;
+	std::size_t i = 0;
+	while (i < m_entities.size())
+	{
+		CompactEntity& entity = m_entities[i];
+		if (entity.freeze > 0)
+			--entity.freeze;
+		else if (++entity.progress == pace(entity).count)
+		{
+			const Edge& edge = world_ref.getEdge(entity.edge);
+			if (edge.terminal)
+			{
+				damage += m_forces[entity.type];
+				entity = m_entities.back();
+				m_entities.pop_back();
+				continue;
+			}
+			entity.edge = world_ref.getRandomEdge(edge.head, m_random);
+			entity.progress = 0;
+		}
+		++i;
+	}
+	return damage;
+}
+
+std::size_t Horde::size() const
+{
+	return m_entities.size();
+}
+
+std::size_t Horde::footprint() const
+{
+	return m_entities.capacity() * sizeof(CompactEntity) + m_paces.capacity() * sizeof(Pace);
+}
+
+CompactEntity& Horde::operator[](std::size_t index)
+{
+	return m_entities[index];
+}
+
+FixedVector Horde::getPosition(std::size_t index) const
+{
+	const CompactEntity& entity = m_entities[index];
+	const Pace& entity_pace = pace(entity);
+	const Edge& edge = World::getInstance().getEdge(entity.edge);
+	return FixedVector(edge.origin.x + entity.progress * entity_pace.step.x,
+		edge.origin.y + entity.progress * entity_pace.step.y);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "fixed.h"
+#include "random.h"
+#include <cstdint>
+#include <vector>
+
+// Compact alternative to Entity for huge crowds: an entity is only the edge it walks
+// along, the number of steps already taken on it and its own counters. Position, step
+// and everything else is derived from the World edge table and the entity records, and
+// evolves exactly like the position of an Entity of the same type on the same edge.
+
+struct CompactEntity
+{
+	std::int32_t edge = 0;
+	std::int32_t progress = 0; // steps taken along the edge, each one speed long
+	std::int32_t health = 0;
+	std::uint16_t type = 0;
+	std::uint16_t freeze = 0;
+};
+
+static_assert(sizeof(CompactEntity) == 16, "CompactEntity is meant to take 16 bytes");
+
+class Horde
+{
+private:
+
+	struct Pace
+	{
+		FixedVector step;
+		int count = 1;
+	};
+
+	std::vector<CompactEntity> m_entities;
+	std::vector<Pace> m_paces; // per edge and type
+	std::vector<std::int32_t> m_healths; // per type
+	std::vector<int> m_forces; // per type
+	int m_types_number = 0;
+	Random m_random;
+
+	const Pace& pace(const CompactEntity& entity) const;
+
+public:
+
+	Horde(int types_number, std::uint64_t seed = 1);
+
+	void reserve(std::size_t count);
+	void spawn(int type);
+	int move();
+
+	std::size_t size() const;
+	std::size_t footprint() const;
+	CompactEntity& operator[](std::size_t index);
+	FixedVector getPosition(std::size_t index) const;
+};
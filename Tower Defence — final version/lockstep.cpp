@@ -0,0 +1,480 @@
+#include "lockstep.h"
+#include "arguments.h"
+#include "engine.h"
+#include "error.h"
+#include "workers.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+const Lockstep::Pace& Lockstep::pace(int slot) const
+{
+	return m_paces[m_edge[slot] * m_types_number + m_type[slot]];
+}
+
+void Lockstep::spawn(int game)
+{
+	if (m_cursors[game] == m_wave_ends[m_waves[game]])
+	{
+		m_spawning[game] = false;
+		return;
+	}
+	World& world_ref = World::getInstance();
+	Random& random = m_randoms[game];
+	// entities are dealt to the segments in turn and join the end of theirs
+	int segments = m_first_towers[game + 1] - m_first_towers[game];
+	int segment = segments > 0 ? m_inserters[game]++ % segments : 0;
+	int first = game * m_capacity, last = first + m_counts[game]++;
+	int slot = static_cast<int>(std::upper_bound(m_segment.begin() + first, m_segment.begin() + last, segment)
+		- m_segment.begin());
+	for (int i = last; i > slot; --i)
+		keep(i - 1, i);
+	int type = m_timeline[m_cursors[game]++];
+	m_segment[slot] = static_cast<std::uint16_t>(segment);
+	m_type[slot] = static_cast<std::uint16_t>(type);
+	m_edge[slot] = world_ref.getRandomEdge(world_ref.getRandomSource(random), random);
+	m_remaining[slot] = pace(slot).count;
+	m_health[slot] = m_healths[type];
+	m_freeze[slot] = 0;
+	if (m_cursors[game] == m_wave_ends[m_waves[game]])
+	{
+		++m_waves[game];
+		m_spawning[game] = false;
+	}
+}
+
+void Lockstep::attack(int game)
+{
+	int first = game * m_capacity, count = m_counts[game];
+	for (int slot = first; slot < first + count; ++slot)
+	{
+		const Pace& step = pace(slot);
+		const Edge& edge = World::getInstance().getEdge(m_edge[slot]);
+		Fixed done = step.count - m_remaining[slot];
+		m_xs[slot] = toRangeUnits(edge.origin.x + step.step.x * done);
+		m_ys[slot] = toRangeUnits(edge.origin.y + step.step.y * done);
+	}
+	for (int i = m_first_towers[game]; i < m_first_towers[game + 1]; ++i)
+	{
+		Tower& tower = m_towers[i];
+		if (++tower.counter >= tower.period)
+			tower.counter = 0;
+	}
+
+	// the rounds of Simulation::doAttacking: in round r defence j scans segment j + r
+	Tower* towers = &m_towers[m_first_towers[game]];
+	int segments = m_first_towers[game + 1] - m_first_towers[game];
+	m_bounds.assign(segments + 1, first + count);
+	for (int slot = first + count - 1; slot >= first; --slot)
+		m_bounds[m_segment[slot]] = slot;
+	for (int segment = segments - 1; segment >= 0; --segment)
+		m_bounds[segment] = std::min(m_bounds[segment], m_bounds[segment + 1]);
+	for (int round = 0; round < segments; ++round)
+	{
+		bool any = false;
+		for (int j = 0; j < segments; ++j)
+		{
+			Tower& tower = towers[j];
+			if (tower.counter != 0 or tower.hits_done >= tower.hits)
+				continue;
+			any = true;
+			int segment = (j + round) % segments;
+			int end = m_bounds[segment + 1];
+			for (int block = m_bounds[segment]; block < end and tower.hits_done < tower.hits; block += RANGE_BLOCK)
+			{
+				unsigned int mask = rangeMask(&m_xs[block], &m_ys[block], std::min(RANGE_BLOCK, end - block),
+					tower.x, tower.y, tower.squared_radius);
+				for (int slot = block; mask != 0U and tower.hits_done < tower.hits; ++slot, mask >>= 1)
+				{
+					if (not (mask & 1U))
+						continue;
+					if (not tower.freezer)
+					{
+						m_health[slot] -= tower.force;
+						++tower.hits_done;
+					}
+					else if (m_freeze[slot] == 0)
+					{
+						m_freeze[slot] = static_cast<std::uint16_t>(tower.force);
+						++tower.hits_done;
+					}
+				}
+			}
+		}
+		if (not any)
+			break;
+	}
+	for (int j = 0; j < segments; ++j)
+		towers[j].hits_done = 0;
+
+	int target = first;
+	for (int slot = first; slot < first + count; ++slot)
+	{
+		if (m_health[slot] > 0)
+			keep(slot, target++);
+		else
+			m_money[game] += m_prizes[m_type[slot]];
+	}
+	m_counts[game] = target - first;
+}
+
+void Lockstep::keep(int slot, int target)
+{
+	m_edge[target] = m_edge[slot];
+	m_remaining[target] = m_remaining[slot];
+	m_health[target] = m_health[slot];
+	m_type[target] = m_type[slot];
+	m_freeze[target] = m_freeze[slot];
+	m_segment[target] = m_segment[slot];
+}
+
+void Lockstep::move(int game)
+{
+	// a frozen entity spends a tick of its freeze instead of a step
+	int first = game * m_capacity, last = first + m_counts[game];
+	std::int32_t* remaining = m_remaining.data();
+	std::uint16_t* freeze = m_freeze.data();
+	for (int i = first; i < last; ++i)
+	{
+		std::int32_t frozen = freeze[i] != 0;
+		freeze[i] = static_cast<std::uint16_t>(freeze[i] - frozen);
+		remaining[i] -= 1 - frozen;
+	}
+
+	int slot = first;
+	while (slot < last and remaining[slot] != 0)
+		++slot;
+	if (slot == last)
+		return;
+	// arrivals take new edges or leave through a tower; the rest keeps its order,
+	// which decides the targets of the defences
+	World& world_ref = World::getInstance();
+	int target = slot;
+	for (; slot < last; ++slot)
+	{
+		if (remaining[slot] == 0)
+		{
+			const Edge& edge = world_ref.getEdge(m_edge[slot]);
+			if (edge.terminal)
+			{
+				++m_leaks[game];
+				m_health_left[game] -= m_forces[m_type[slot]];
+				continue;
+			}
+			m_edge[slot] = world_ref.getRandomEdge(edge.head, m_randoms[game]);
+			remaining[slot] = pace(slot).count;
+		}
+		keep(slot, target++);
+	}
+	m_counts[game] = target - first;
+	if (m_health_left[game] <= 0)
+		finish(game, Result::Failure);
+}
+
+void Lockstep::finish(int game, Result result)
+{
+	m_over[game] = true;
+	m_results[game] = result;
+	m_end_ticks[game] = m_tick;
+	m_counts[game] = 0;
+}
+
+Lockstep::Lockstep(const Level& level, const std::vector<Layout>& layouts, int money, std::uint64_t first_seed) :
+	m_games(static_cast<int>(layouts.size()))
+{
+	Manager& manager_ref = Manager::getInstance();
+	World& world_ref = World::getInstance();
+
+	m_types_number = manager_ref.getEntitiesNumber();
+	for (int i = 0; i < m_types_number; ++i)
+	{
+		const EntityRecord& record = manager_ref.getEntityRecord(i);
+		m_healths.push_back(record.health);
+		m_forces.push_back(record.force);
+		m_prizes.push_back(record.prize);
+	}
+	for (int i = 0; i < world_ref.getEdgesNumber(); ++i)
+	{
+		const Edge& edge = world_ref.getEdge(i);
+		for (int type = 0; type < m_types_number; ++type)
+		{
+			Fixed speed = toFixed(manager_ref.getEntityRecord(type).speed);
+			Pace pace;
+			pace.step = edge.step(speed);
+			pace.count = edge.stepsCount(speed);
+			m_paces.push_back(pace);
+		}
+	}
+	Level copy = level;
+	while (not copy.empty())
+	{
+		Wave& wave = copy.front();
+		while (not wave.empty())
+		{
+			for (int i = 0; i < wave.front().count; ++i)
+				m_timeline.push_back(static_cast<std::uint16_t>(wave.front().index));
+			wave.pop();
+		}
+		m_wave_ends.push_back(static_cast<int>(m_timeline.size()));
+		copy.pop();
+	}
+	m_wave_ends.push_back(static_cast<int>(m_timeline.size()));
+
+	m_capacity = std::max(1, static_cast<int>(m_timeline.size()));
+	std::size_t slots = static_cast<std::size_t>(m_games) * m_capacity;
+	m_edge.assign(slots, 0);
+	m_remaining.assign(slots, 0);
+	m_health.assign(slots, 0);
+	m_type.assign(slots, 0);
+	m_freeze.assign(slots, 0);
+	m_segment.assign(slots, 0);
+	m_xs.assign(slots + RANGE_BLOCK, 0);
+	m_ys.assign(slots + RANGE_BLOCK, 0);
+
+	m_counts.assign(m_games, 0);
+	m_cursors.assign(m_games, 0);
+	m_waves.assign(m_games, 0);
+	m_spawn_counters.assign(m_games, 1);
+	m_inserters.assign(m_games, 0);
+	m_health_left.assign(m_games, INITIAL_HEALTH);
+	m_money.assign(m_games, money);
+	m_leaks.assign(m_games, 0);
+	m_spawning.assign(m_games, false);
+	m_fighting.assign(m_games, false);
+	m_over.assign(m_games, false);
+	m_results.assign(m_games, Result::Interrupt);
+	m_end_ticks.assign(m_games, 0);
+	for (int game = 0; game < m_games; ++game)
+	{
+		m_running.push_back(game);
+		Random& random = m_randoms.emplace_back(first_seed + game);
+		m_first_towers.push_back(static_cast<int>(m_towers.size()));
+		for (const Placement& placement : layouts[game])
+		{
+			const DefenceRecord& record = manager_ref.getDefenceRecord(placement.type);
+			if (m_money[game] < record.cost)
+				continue;
+			m_money[game] -= record.cost;
+			Tower& tower = m_towers.emplace_back();
+			FixedVector position = toFixed(static_cast<sf::Vector2f>(placement.position));
+			tower.x = toRangeUnits(position.x);
+			tower.y = toRangeUnits(position.y);
+			tower.squared_radius = squaredRange(toFixed(record.radius));
+			tower.period = record.period;
+			tower.counter = random.below(record.period);
+			tower.force = record.force;
+			tower.hits = record.hits;
+			tower.freezer = placement.type == DefenceType::Freezer;
+			tower.type = placement.type;
+		}
+	}
+	m_first_towers.push_back(static_cast<int>(m_towers.size()));
+}
+
+void Lockstep::tick()
+{
+	++m_tick;
+	for (int game : m_running)
+	{
+		if (not m_fighting[game])
+			m_spawning[game] = m_fighting[game] = true;
+		if (m_spawning[game] and --m_spawn_counters[game] == 0)
+		{
+			spawn(game);
+			m_spawn_counters[game] = SPAWN_PERIOD;
+		}
+	}
+	if (--m_attack_counter <= 0)
+	{
+		m_attack_counter = ATTACK_PERIOD;
+		for (int game : m_running)
+		{
+			if (m_counts[game] > 0 and m_first_towers[game] < m_first_towers[game + 1])
+				attack(game);
+		}
+	}
+	for (int game : m_running)
+		move(game);
+	for (int game : m_running)
+	{
+		if (m_over[game] or not m_fighting[game] or m_spawning[game] or m_counts[game] > 0)
+			continue;
+		m_fighting[game] = false;
+		m_spawn_counters[game] = 1;
+		m_inserters[game] = 0;
+		if (m_waves[game] + 1 >= m_wave_ends.size())
+			finish(game, Result::Victory);
+	}
+	std::erase_if(m_running, [this](int game) { return m_over[game] != 0; });
+}
+
+bool Lockstep::isOver() const
+{
+	return m_running.empty();
+}
+
+int Lockstep::getGamesNumber() const
+{
+	return m_games;
+}
+
+Outcome Lockstep::getOutcome(int game) const
+{
+	Outcome outcome;
+	outcome.result = m_results[game];
+	outcome.health = m_health_left[game];
+	outcome.leaks = m_leaks[game];
+	outcome.ticks = m_over[game] ? m_end_ticks[game] : m_tick;
+	return outcome;
+}
+
+void Lockstep::dump(int game, StateDump& dump) const
+{
+	// a game that is over stops with the tick that ended it
+	dump.tick = m_over[game] ? m_end_ticks[game] : m_tick;
+	dump.random = m_randoms[game].getState();
+	dump.health = m_health_left[game];
+	dump.money = m_money[game];
+	dump.leaks = m_leaks[game];
+	dump.spawn_counter = m_spawn_counters[game];
+	dump.attack_counter = m_attack_counter;
+	dump.waves_left = static_cast<int>(m_wave_ends.size()) - 1 - m_waves[game];
+	dump.entities_left = static_cast<int>(m_timeline.size()) - m_cursors[game];
+	dump.next_type = dump.entities_left > 0 ? m_timeline[m_cursors[game]] : -1;
+	dump.spawning = m_spawning[game] != 0;
+	dump.fighting = m_fighting[game] != 0;
+	dump.over = m_over[game] != 0;
+	dump.result = m_results[game];
+	dump.entities.clear();
+	int first = game * m_capacity;
+	for (int slot = first; slot < first + m_counts[game]; ++slot)
+	{
+		const Pace& step = pace(slot);
+		const Edge& edge = World::getInstance().getEdge(m_edge[slot]);
+		Fixed done = step.count - m_remaining[slot];
+		EntityDump& entry = dump.entities.emplace_back();
+		entry.type = m_type[slot];
+		entry.health = m_health[slot];
+		entry.freeze = m_freeze[slot];
+		entry.position = FixedVector(edge.origin.x + step.step.x * done, edge.origin.y + step.step.y * done);
+	}
+	dump.defences.clear();
+	for (int i = m_first_towers[game]; i < m_first_towers[game + 1]; ++i)
+	{
+		DefenceDump& entry = dump.defences.emplace_back();
+		entry.type = m_towers[i].type;
+		entry.counter = m_towers[i].counter;
+	}
+}
+
+std::vector<Outcome> playLockstep(const Level& level, const std::vector<Layout>& layouts, int money,
+	std::uint64_t first_seed, Workers& workers)
+{
+	struct Batch
+	{
+		const Level* level;
+		const std::vector<Layout>* layouts;
+		int money;
+		std::uint64_t first_seed;
+		int shard;
+		std::vector<Outcome> outcomes;
+	};
+	// smaller shards when there are too few games to keep every thread busy
+	int games = static_cast<int>(layouts.size()), threads = workers.getThreadsNumber();
+	int shard = std::clamp((games + threads - 1) / threads, 1, LOCKSTEP_SHARD);
+	Batch batch{ &level, &layouts, money, first_seed, shard, std::vector<Outcome>(layouts.size()) };
+	workers.run((games + shard - 1) / shard, [](void* context, int task)
+		{
+			Batch& batch = *static_cast<Batch*>(context);
+			int first = task * batch.shard;
+			int last = std::min(first + batch.shard, static_cast<int>(batch.layouts->size()));
+			std::vector<Layout> shard(batch.layouts->begin() + first, batch.layouts->begin() + last);
+			Lockstep lockstep(*batch.level, shard, batch.money, batch.first_seed + first);
+			while (not lockstep.isOver())
+				lockstep.tick();
+			for (int game = first; game < last; ++game)
+				batch.outcomes[game] = lockstep.getOutcome(game - first);
+		}, &batch);
+	return batch.outcomes;
+}
+
+int runLockstep(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		std::cout << "Usage: lockstep \"<map name>\" \"<level name>\" <games count>" << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::string map_name = argv[2], level_name = argv[3];
+		int games = std::max(1, parseInt(argv[4]));
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		manager_ref.loadMap(map_name);
+		Level level;
+		manager_ref.loadLevel(level_name, level);
+		std::vector<Layout> references = referenceLayouts(INITIAL_MONEY);
+		std::vector<Layout> layouts;
+		for (int i = 0; i < games; ++i)
+			layouts.push_back(references[i % REFERENCES_NUMBER]);
+
+		auto report = [games](const char* name, const std::vector<Outcome>& outcomes, double seconds)
+		{
+			long long ticks = 0;
+			int victories = 0;
+			for (const Outcome& outcome : outcomes)
+			{
+				ticks += outcome.ticks;
+				victories += outcome.result == Result::Victory;
+			}
+			std::cout << name << ": " << seconds << " s, " << victories << " of " << games << " won, "
+				<< ticks / std::max(seconds, 1e-9) / 1e6 << " million game ticks per second" << std::endl;
+		};
+
+		// both on all threads, the same games in the same shares
+		int threads = std::max(1U, std::thread::hardware_concurrency());
+		Workers workers(threads - 1);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<Outcome> outcomes = playLockstep(level, layouts, INITIAL_MONEY, 1, workers);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		report(("Lockstep, " + std::to_string(threads) + " threads").c_str(), outcomes, elapsed.count());
+
+		struct Batch
+		{
+			const Level* level;
+			const std::vector<Layout>* layouts;
+			std::vector<Outcome> outcomes;
+		};
+		Batch batch{ &level, &layouts, std::vector<Outcome>(games) };
+		start = std::chrono::steady_clock::now();
+		workers.run(games, [](void* context, int task)
+			{
+				Batch& batch = *static_cast<Batch*>(context);
+				batch.outcomes[task] = playHeadless(*batch.level, (*batch.layouts)[task], INITIAL_MONEY, task + 1);
+			}, &batch);
+		elapsed = std::chrono::steady_clock::now() - start;
+		report(("Separate simulations, " + std::to_string(threads) + " threads").c_str(), batch.outcomes,
+			elapsed.count());
+
+		int differing = 0;
+		for (int i = 0; i < games; ++i)
+		{
+			const Outcome& left = outcomes[i];
+			const Outcome& right = batch.outcomes[i];
+			differing += left.result != right.result or left.health != right.health or left.ticks != right.ticks;
+		}
+		std::cout << differing << " games played out differently" << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "headless.h"
+#include "random.h"
+#include "range.h"
+#include "workers.h"
+#include <cstdint>
+#include <vector>
+
+// Many games of one map and level advanced together, for batch evaluation. Entities of
+// all games live in one set of arrays, game after game, and the walk along the edges is
+// a branch-free pass over the live slots of every running game: frozen entities are
+// masked out arithmetically, and an entity only needs attention when its steps run out. Range
+// tests run on the same arrays with the block kernel. Each game keeps its own layout,
+// seed, wave progress, money and health, and starts a wave as soon as the last one ends.
+// The slots of a game are kept in the order of Simulation's entity list, segment after
+// segment, so a game plays out exactly as playHeadless with the same layout and seed.
+// A batch is played in shards of LOCKSTEP_SHARD games, each shard in lockstep and the
+// shards spread over the workers as playHeadless games would be: the arrays of more games
+// spill out of the caches and lose more than the shared passes gain.
+// Usage: lockstep "<map name>" "<level name>" <games count>
+
+const int LOCKSTEP_SHARD = 64; // games at most, fewer when a batch is small for the threads
+
+class Lockstep
+{
+private:
+
+	struct Pace
+	{
+		FixedVector step;
+		std::int32_t count = 1;
+	};
+
+	struct Tower
+	{
+		RangeUnit x = 0;
+		RangeUnit y = 0;
+		std::int32_t squared_radius = 0;
+		int period = 1;
+		int counter = 0;
+		int force = 0;
+		int hits = 0;
+		int hits_done = 0;
+		bool freezer = false;
+		DefenceType type = DefenceType::None;
+	};
+
+	int m_games = 0;
+	int m_capacity = 0; // slots per game, enough for the whole level alive at once
+
+	// entity slots; game g owns [g * m_capacity, g * m_capacity + m_counts[g])
+	std::vector<std::int32_t> m_edge;
+	std::vector<std::int32_t> m_remaining; // steps left on the edge
+	std::vector<std::int32_t> m_health;
+	std::vector<std::uint16_t> m_type;
+	std::vector<std::uint16_t> m_freeze;
+	std::vector<std::uint16_t> m_segment; // the defence whose segment holds the entity
+	std::vector<RangeUnit> m_xs; // positions for the range tests, refreshed before attacks
+	std::vector<RangeUnit> m_ys;
+
+	// shared by all games
+	int m_types_number = 0;
+	std::vector<Pace> m_paces; // per edge and type
+	std::vector<std::int32_t> m_healths, m_forces, m_prizes; // per type
+	std::vector<std::uint16_t> m_timeline; // the level's entities in spawn order
+	std::vector<int> m_wave_ends; // timeline index after each wave
+	std::uint64_t m_tick = 0;
+	int m_attack_counter = ATTACK_PERIOD;
+	std::vector<int> m_running; // games not over yet
+	std::vector<int> m_bounds; // segment starts of the game under attack
+
+	// per game
+	std::vector<int> m_counts, m_cursors, m_waves, m_spawn_counters, m_inserters;
+	std::vector<int> m_health_left, m_money, m_leaks;
+	std::vector<std::uint8_t> m_spawning, m_fighting, m_over;
+	std::vector<Result> m_results;
+	std::vector<std::uint64_t> m_end_ticks;
+	std::vector<Random> m_randoms;
+	std::vector<Tower> m_towers; // game after game
+	std::vector<int> m_first_towers;
+
+	const Pace& pace(int slot) const;
+	void spawn(int game);
+	void attack(int game);
+	void keep(int slot, int target);
+	void move(int game);
+	void finish(int game, Result result);
+
+public:
+
+	Lockstep(const Level& level, const std::vector<Layout>& layouts, int money, std::uint64_t first_seed);
+
+	void tick();
+	bool isOver() const;
+	int getGamesNumber() const;
+	Outcome getOutcome(int game) const;
+	void dump(int game, StateDump& dump) const; // as Simulation::dump would after the same tick
+};
+
+// game i is played with the layout i and the seed first_seed + i
+std::vector<Outcome> playLockstep(const Level& level, const std::vector<Layout>& layouts, int money,
+	std::uint64_t first_seed, Workers& workers);
+
+int runLockstep(int argc, char* argv[]);
@@ -1,17 +1,101 @@
+#include "arguments.h"
+#include "determinism.h"
 #include "engine.h"
 #include "error.h"
+#include "export.h"
+#include "lockstep.h"
+#include "matrix.h"
+#include "netplay.h"
+#include "optimizer.h"
+#include "profile.h"
+#include "replay.h"
+#include "stream.h"
+#include "stress.h"
+#include "sweep.h"
+#include "tournament.h"
 #include <iostream>
+#include <string>
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #include <SFML/Network.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
-int main()
+int main(int argc, char* argv[])
 {
+	PROFILE_THREAD("main");
+	// the game and the tools alike stream and export the games they play when asked to
+	for (int i = 1; i + 1 < argc;)
+	{
+		std::string option = argv[i];
+		if (option != "--stream" and option != "--export")
+		{
+			++i;
+			continue;
+		}
+		try
+		{
+			if (option == "--stream")
+				openStream(parsePort(argv[i + 1]));
+			else
+				openExport(argv[i + 1]);
+		}
+		catch (Error err)
+		{
+			std::cout << "An error has been encountered:" << std::endl << std::endl
+				<< "\t" << err.what() << std::endl << std::endl;
+			return 1;
+		}
+		for (int j = i; j + 2 <= argc; ++j)
+			argv[j] = argv[j + 2];
+		argc -= 2;
+	}
+	if (argc > 1 and std::string(argv[1]) == "stress")
+		return runStress(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "optimize")
+		return runOptimizer(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "matrix")
+		return runMatrix(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "sweep")
+		return runSweep(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "lockstep")
+		return runLockstep(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "tournament")
+		return runTournament(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "bot")
+		return runBotHost(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "replay")
+		return runReplay(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "coop")
+		return runCoop(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "monitor")
+		return runMonitor(argc, argv);
+	if (argc > 1 and std::string(argv[1]) == "determinism")
+		return runDeterminism(argc, argv);
+
 	Engine& engine = Engine::getInstance();
 	try
 	{
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			std::string option = argv[i];
+			if (option == "--tick-rate")
+				engine.setTickRate(parseInt(argv[i + 1]));
+			else if (option == "--frame-rate")
+				engine.setFrameRate(parseInt(argv[i + 1]));
+			else if (option == "--record")
+				engine.setReplayPath(argv[i + 1]);
+			else if (option == "--load")
+				engine.setLoadPath(argv[i + 1]);
+			else if (option == "--host")
+				engine.setHostPort(parsePort(argv[i + 1]));
+			else if (option == "--join")
+				engine.setJoinAddress(argv[i + 1]);
+			else if (option == "--watch")
+				engine.setWatchAddress(argv[i + 1]);
+			else if (option == "--hitch")
+				engine.setHitchBudget(parseDouble(argv[i + 1]));
+		}
 		engine.prepare();
 		while (engine.running())
 		{
@@ -1,7 +1,9 @@
 #include "manager.h"
 #include "engine.h"
 #include "error.h"
+#include "profile.h"
 #include "world.h"
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <future>
@@ -67,34 +69,38 @@ int Manager::overflowSelection(sf::RenderWindow& window, sf::Text& request)
             window.display();
             redraw = false;
         }
-        while (window.pollEvent(event))
+        // the list only changes on input, so sleep until there is some
+        if (not window.waitEvent(event))
+            throw Error(Problem::Interrupt);
+        switch (event.type)
         {
-            switch (event.type)
+        case sf::Event::MouseButtonPressed:
+            if (event.mouseButton.button == sf::Mouse::Left)
             {
-            case sf::Event::MouseButtonPressed:
-                if (event.mouseButton.button == sf::Mouse::Left)
+                sf::Vector2f mouse_position = static_cast<sf::Vector2f>(sf::Mouse::getPosition(window));
+                sf::Vector2f window_size = static_cast<sf::Vector2f>(window.getSize());
+                if (withinMargins(mouse_position, window_size))
                 {
-                    sf::Vector2f mouse_position = static_cast<sf::Vector2f>(sf::Mouse::getPosition(window));
-                    sf::Vector2f window_size = static_cast<sf::Vector2f>(window.getSize());
-                    if (withinMargins(mouse_position, window_size))
-                    {
-                        selected = (mouse_position.y - MARGIN[TOP]) / TEXT_SIZE + m_skipped_count;
-                        ready = true;
-                    }
+                    selected = (mouse_position.y - MARGIN[TOP]) / TEXT_SIZE + m_skipped_count;
+                    ready = true;
                 }
-                break;
-            case sf::Event::MouseWheelScrolled:
-            {
-                int scroll = static_cast<int>(event.mouseWheelScroll.delta);
-                int upper_limit = static_cast<int>(m_texts.size()) - m_shown_count;
-                m_skipped_count = std::max(std::min(m_skipped_count - scroll, upper_limit), 0);
-            }
-                redraw = true;
-                break;
-            case sf::Event::Closed:
-                window.close();
-                throw Error(Problem::Interrupt);
             }
+            break;
+        case sf::Event::MouseWheelScrolled:
+        {
+            int scroll = static_cast<int>(event.mouseWheelScroll.delta);
+            int upper_limit = static_cast<int>(m_texts.size()) - m_shown_count;
+            m_skipped_count = std::max(std::min(m_skipped_count - scroll, upper_limit), 0);
+        }
+            redraw = true;
+            break;
+        case sf::Event::Resized:
+        case sf::Event::GainedFocus:
+            redraw = true;
+            break;
+        case sf::Event::Closed:
+            window.close();
+            throw Error(Problem::Interrupt);
         }
     } while (not ready);
     return selected;
@@ -103,34 +109,42 @@ int Manager::overflowSelection(sf::RenderWindow& window, sf::Text& request)
 int Manager::normalSelection(sf::RenderWindow& window, sf::Text& request)
 {
     sf::Event event = sf::Event();
-    bool ready = false;
+    bool ready = false, redraw = true;
     int selected = -1;
-    window.draw(request);
-    for (const auto& n : m_texts)
-        window.draw(n);
-    window.display();
     do {
-        while (window.pollEvent(event))
+        if (redraw)
         {
-            switch (event.type)
+            window.clear();
+            window.draw(request);
+            for (const auto& n : m_texts)
+                window.draw(n);
+            window.display();
+            redraw = false;
+        }
+        if (not window.waitEvent(event))
+            throw Error(Problem::Interrupt);
+        switch (event.type)
+        {
+        case sf::Event::MouseButtonPressed:
+            if (event.mouseButton.button == sf::Mouse::Left)
             {
-            case sf::Event::MouseButtonPressed:
-                if (event.mouseButton.button == sf::Mouse::Left)
+                sf::Vector2f mouse_position = static_cast<sf::Vector2f>(sf::Mouse::getPosition(window));
+                sf::Vector2f window_size = static_cast<sf::Vector2f>(window.getSize());
+                if (withinMargins(mouse_position, window_size))
                 {
-                    sf::Vector2f mouse_position = static_cast<sf::Vector2f>(sf::Mouse::getPosition(window));
-                    sf::Vector2f window_size = static_cast<sf::Vector2f>(window.getSize());
-                    if (withinMargins(mouse_position, window_size))
-                    {
-                        selected = (mouse_position.y - MARGIN[TOP]) / TEXT_SIZE;
-                        if (selected < m_shown_count)
-                            ready = true;
-                    }
+                    selected = (mouse_position.y - MARGIN[TOP]) / TEXT_SIZE;
+                    if (selected < m_shown_count)
+                        ready = true;
                 }
-                break;
-            case sf::Event::Closed:
-                window.close();
-                throw Error(Problem::Interrupt);
             }
+            break;
+        case sf::Event::Resized:
+        case sf::Event::GainedFocus:
+            redraw = true;
+            break;
+        case sf::Event::Closed:
+            window.close();
+            throw Error(Problem::Interrupt);
         }
     } while (not ready);
     return selected;
@@ -551,6 +565,7 @@ void Manager::prepareLevelNames(float window_height)
 
 void Manager::loadFont()
 {
+    PROFILE_ZONE("Manager::loadFont");
     if (not m_arial.loadFromFile(FONT_FILE))
         throw Error(Problem::FileError);
 }
@@ -562,6 +577,7 @@ const sf::Font& Manager::shareFont()
 
 void Manager::checkMaps()
 {
+    PROFILE_ZONE("Manager::checkMaps");
     std::filesystem::path source(MAPS_DIR);
     if (not std::filesystem::exists(source))
         throw Error(Problem::FileError);
@@ -608,11 +624,20 @@ void Manager::loadMap(sf::RenderWindow& window, std::string& map_name)
 {
     prepareMapNames(static_cast<float>(window.getSize().y));
     map_name = selectText(window, "Please select a map (click):");
+    loadMap(map_name);
+}
+
+void Manager::loadMap(const std::string& map_name)
+{
+    PROFILE_ZONE("Manager::loadMap");
+    if (m_maps_dictionary.find(map_name) == m_maps_dictionary.end())
+        throw Error(Problem::FileError);
     std::filesystem::path source = m_maps_dictionary.at(map_name);
     if (not std::filesystem::exists(source))
         throw Error(Problem::FileError);
     Graph graph;
-    bool result = extractFile(source, map_name, graph);
+    std::string name;
+    bool result = extractFile(source, name, graph);
     if (result)
         result = findSimpleErrors(graph);
     if (result)
@@ -622,12 +647,35 @@ void Manager::loadMap(sf::RenderWindow& window, std::string& map_name)
     {
         refactorGraph(graph);
         world.loadMap(graph);
+        m_map_name = map_name;
     }
     graph.body.clear();
 }
 
+std::vector<std::string> Manager::getMapNames() const
+{
+    std::vector<std::string> names;
+    for (const auto& [name, path] : m_maps_dictionary)
+        names.push_back(name);
+    return names;
+}
+
+std::filesystem::path Manager::getMapPath(const std::string& map_name) const
+{
+    auto it = m_maps_dictionary.find(map_name);
+    if (it == m_maps_dictionary.end())
+        throw Error(Problem::FileError);
+    return it->second;
+}
+
+const std::string& Manager::getMapName() const
+{
+    return m_map_name;
+}
+
 void Manager::checkLevels()
 {
+    PROFILE_ZONE("Manager::checkLevels");
     std::filesystem::path source(LEVELS_DIR);
     if (not std::filesystem::exists(source))
         throw Error(Problem::FileError);
@@ -649,6 +697,14 @@ void Manager::loadLevel(sf::RenderWindow& window, Level& level, std::string& lev
     window.clear();
     prepareLevelNames(static_cast<float>(window.getSize().y));
     level_name = selectText(window, "Please select a level of difficulty (click):");
+    loadLevel(level_name, level);
+}
+
+void Manager::loadLevel(const std::string& level_name, Level& level)
+{
+    PROFILE_ZONE("Manager::loadLevel");
+    if (m_levels_dictionary.find(level_name) == m_levels_dictionary.end())
+        throw Error(Problem::FileError);
     std::filesystem::path path = m_levels_dictionary.at(level_name);
     if (not std::filesystem::exists(path))
         throw Error(Problem::FileError);
@@ -656,8 +712,26 @@ void Manager::loadLevel(sf::RenderWindow& window, Level& level, std::string& lev
         throw Error(Problem::FileError);
 }
 
+std::vector<std::string> Manager::getLevelNames() const
+{
+    std::vector<std::string> names;
+    for (const auto& [name, path] : m_levels_dictionary)
+        names.push_back(name);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::filesystem::path Manager::getLevelPath(const std::string& level_name) const
+{
+    auto it = m_levels_dictionary.find(level_name);
+    if (it == m_levels_dictionary.end())
+        throw Error(Problem::FileError);
+    return it->second;
+}
+
 void Manager::readEntitiesData()
 {
+    PROFILE_ZONE("Manager::readEntitiesData");
     std::filesystem::path source(ENTITIES_DIR);
     source /= ENTITIES_SOURCE;
     if (not std::filesystem::exists(source))
@@ -716,7 +790,8 @@ void Manager::readEntitiesData()
     file.close();
     for (auto it = m_entities_data.begin(); it != m_entities_data.end(); ++it)
     {
-        if (not it->loadTexture())
+        // the speed is a divisor in the fixed-point steps, so it must not round to zero
+        if (toFixed(it->speed) <= 0 or not it->loadTexture())
         {
             m_entities_dictionary.clear();
             m_entities_data.clear();
@@ -725,7 +800,7 @@ void Manager::readEntitiesData()
     }
 }
 
-const EntityRecord& Manager::getEntityRecord(int index)
+EntityRecord& Manager::getEntityRecord(int index)
 {
     try
     {
@@ -737,8 +812,27 @@ const EntityRecord& Manager::getEntityRecord(int index)
     }
 }
 
+int Manager::getEntityIndex(const std::string& label)
+{
+    auto it = m_entities_dictionary.find(label);
+    if (it == m_entities_dictionary.end())
+        throw Error(Problem::OutOfRange);
+    return it->second;
+}
+
+bool Manager::hasEntity(const std::string& label) const
+{
+    return m_entities_dictionary.find(label) != m_entities_dictionary.end();
+}
+
+int Manager::getEntitiesNumber()
+{
+    return static_cast<int>(m_entities_data.size());
+}
+
 void Manager::readDefencesData()
 {
+    PROFILE_ZONE("Manager::readDefencesData");
     std::filesystem::path source(DEFENCES_DIR);
     source /= DEFENCES_SOURCE;
     if (not std::filesystem::exists(source))
@@ -808,7 +902,7 @@ DefenceRecord& Manager::getDefenceRecord(DefenceType type)
 {
     try
     {
-        m_defences_data.at(type);
+        return m_defences_data.at(type);
     }
     catch (...)
     {
@@ -86,6 +86,7 @@ private:
 	// maps //
 
 	std::map<std::string, std::filesystem::path> m_maps_dictionary; // name-to-files
+	std::string m_map_name; // of the map loaded last
 
 	void prepareMapNames(float window_height);
 
@@ -123,12 +124,22 @@ public:
 
 	void checkMaps();
 	void loadMap(sf::RenderWindow& window, std::string& map_name);
+	void loadMap(const std::string& map_name);
+	std::vector<std::string> getMapNames() const;
+	std::filesystem::path getMapPath(const std::string& map_name) const;
+	const std::string& getMapName() const;
 
 	void checkLevels();
 	void loadLevel(sf::RenderWindow& window, Level& level, std::string& map_name);
+	void loadLevel(const std::string& level_name, Level& level);
+	std::vector<std::string> getLevelNames() const;
+	std::filesystem::path getLevelPath(const std::string& level_name) const;
 
 	void readEntitiesData();
-	const EntityRecord& getEntityRecord(int index);
+	EntityRecord& getEntityRecord(int index);
+	int getEntityIndex(const std::string& label);
+	bool hasEntity(const std::string& label) const;
+	int getEntitiesNumber();
 
 	void readDefencesData();
 	DefenceRecord& getDefenceRecord(DefenceType type);
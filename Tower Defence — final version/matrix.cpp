@@ -0,0 +1,234 @@
+#include "matrix.h"
+#include "arguments.h"
+#include "binary.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include "workers.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+const std::string MATRIX_CHECKPOINT = "matrix.checkpoint";
+
+namespace
+{
+	struct Cell
+	{
+		int games = 0;
+		int victories = 0;
+		long long leaks = 0;
+		long long ticks = 0;
+		double seconds = 0.; // spent in the games, summed over threads
+	};
+
+	using CellKey = std::tuple<std::string, std::string, std::string>; // map, level, layout
+
+	// what the cells depend on besides their keys: another number of seeds, another
+	// budget or any changed data file makes the whole checkpoint stale
+	std::string checkpointHeader(int seeds, int budget, const std::vector<std::string>& map_names,
+		const std::vector<std::string>& level_names)
+	{
+		Manager& manager_ref = Manager::getInstance();
+		std::uint64_t hash = hashFile(std::filesystem::path(ENTITIES_DIR) / ENTITIES_SOURCE);
+		hash = hashValue(hash, hashFile(std::filesystem::path(DEFENCES_DIR) / DEFENCES_SOURCE));
+		for (const std::string& map_name : map_names)
+			hash = hashValue(hash, hashFile(manager_ref.getMapPath(map_name)));
+		for (const std::string& level_name : level_names)
+			hash = hashValue(hash, hashFile(manager_ref.getLevelPath(level_name)));
+		std::ostringstream header;
+		header << "matrix\t" << seeds << ' ' << budget << ' ' << std::hex << hash;
+		return header.str();
+	}
+
+	// false when the file is missing or was written for another header
+	bool readCheckpoint(const std::string& path, const std::string& header, std::map<CellKey, Cell>& cells)
+	{
+		std::ifstream file(path);
+		std::string line;
+		if (not std::getline(file, line) or line != header)
+			return false;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string map_name, level_name, layout_name, numbers;
+			if (not std::getline(stream, map_name, '\t') or not std::getline(stream, level_name, '\t')
+				or not std::getline(stream, layout_name, '\t') or not std::getline(stream, numbers))
+				continue;
+			Cell cell;
+			std::istringstream values(numbers);
+			if (values >> cell.games >> cell.victories >> cell.leaks >> cell.ticks >> cell.seconds)
+				cells[{ map_name, level_name, layout_name }] = cell;
+		}
+		return true;
+	}
+
+	void writeCheckpoint(std::ofstream& file, const CellKey& key, const Cell& cell)
+	{
+		file << std::get<0>(key) << '\t' << std::get<1>(key) << '\t' << std::get<2>(key) << '\t'
+			<< cell.games << ' ' << cell.victories << ' ' << cell.leaks << ' ' << cell.ticks << ' '
+			<< cell.seconds << std::endl;
+	}
+
+	void printMatrix(const std::vector<std::string>& map_names, const std::vector<std::string>& level_names,
+		const std::map<CellKey, Cell>& cells)
+	{
+		const int width = 16;
+		for (int reference = 0; reference < REFERENCES_NUMBER; ++reference)
+		{
+			std::cout << std::endl << "Layout \"" << REFERENCE_NAMES[reference]
+				<< "\": win rate, leaks per game" << std::endl << std::setw(width) << "";
+			for (const std::string& level_name : level_names)
+				std::cout << std::setw(width) << level_name;
+			std::cout << std::endl;
+			for (const std::string& map_name : map_names)
+			{
+				std::cout << std::setw(width) << map_name;
+				for (const std::string& level_name : level_names)
+				{
+					auto it = cells.find({ map_name, level_name, REFERENCE_NAMES[reference] });
+					std::ostringstream entry;
+					if (it != cells.end() and it->second.games > 0)
+					{
+						const Cell& cell = it->second;
+						entry << std::fixed << std::setprecision(0) << 100. * cell.victories / cell.games << "% "
+							<< std::setprecision(1) << static_cast<double>(cell.leaks) / cell.games;
+					}
+					else
+						entry << "-";
+					std::cout << std::setw(width) << entry.str();
+				}
+				std::cout << std::endl;
+			}
+		}
+	}
+}
+
+int runMatrix(int argc, char* argv[])
+{
+	try
+	{
+		int seeds = argc > 2 ? std::max(1, parseInt(argv[2])) : 16;
+		int budget = argc > 3 ? parseInt(argv[3]) : INITIAL_MONEY;
+		std::string checkpoint_path = argc > 4 ? argv[4] : MATRIX_CHECKPOINT;
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		std::vector<std::string> map_names = manager_ref.getMapNames();
+		std::vector<std::string> level_names = manager_ref.getLevelNames();
+
+		// levels are parsed once and copied into every game
+		std::vector<Level> levels(level_names.size());
+		for (int i = 0; i < level_names.size(); ++i)
+			manager_ref.loadLevel(level_names[i], levels[i]);
+
+		std::map<CellKey, Cell> cells;
+		std::string header = checkpointHeader(seeds, budget, map_names, level_names);
+		bool resuming = readCheckpoint(checkpoint_path, header, cells);
+		int resumed = static_cast<int>(cells.size());
+		std::ofstream checkpoint(checkpoint_path, resuming ? std::ios::app : std::ios::trunc);
+		if (not resuming)
+			checkpoint << header << std::endl;
+		Workers workers(std::max(1U, std::thread::hardware_concurrency()) - 1);
+
+		struct Batch
+		{
+			const Level* level;
+			std::vector<const Layout*> layouts;
+			int budget;
+			int seeds;
+			std::vector<Outcome> outcomes;
+			std::vector<double> seconds;
+		};
+		auto play = [](void* context, int task)
+		{
+			Batch& batch = *static_cast<Batch*>(context);
+			auto start = std::chrono::steady_clock::now();
+			batch.outcomes[task] = playHeadless(*batch.level, *batch.layouts[task / batch.seeds],
+				batch.budget, task % batch.seeds + 1);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			batch.seconds[task] = elapsed.count();
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		long long games = 0, ticks = 0;
+		for (const std::string& map_name : map_names)
+		{
+			bool done = true;
+			for (const std::string& level_name : level_names)
+			{
+				for (const std::string& reference_name : REFERENCE_NAMES)
+					done = done and cells.count({ map_name, level_name, reference_name }) > 0;
+			}
+			if (done)
+				continue;
+			// the map is parsed once, for all its levels
+			manager_ref.loadMap(map_name);
+			std::vector<Layout> layouts = referenceLayouts(budget);
+			for (int i = 0; i < level_names.size(); ++i)
+			{
+				std::vector<int> pending;
+				for (int reference = 0; reference < REFERENCES_NUMBER; ++reference)
+				{
+					if (cells.count({ map_name, level_names[i], REFERENCE_NAMES[reference] }) == 0)
+						pending.push_back(reference);
+				}
+				if (pending.empty())
+					continue;
+				Batch batch{ &levels[i], {}, budget, seeds, {}, {} };
+				for (int reference : pending)
+					batch.layouts.push_back(&layouts[reference]);
+				int tasks = static_cast<int>(pending.size()) * seeds;
+				batch.outcomes.resize(tasks);
+				batch.seconds.resize(tasks);
+				workers.run(tasks, play, &batch);
+				for (int j = 0; j < pending.size(); ++j)
+				{
+					CellKey key{ map_name, level_names[i], REFERENCE_NAMES[pending[j]] };
+					Cell cell;
+					for (int seed = 0; seed < seeds; ++seed)
+					{
+						const Outcome& outcome = batch.outcomes[j * seeds + seed];
+						++cell.games;
+						cell.victories += outcome.result == Result::Victory;
+						cell.leaks += outcome.leaks;
+						cell.ticks += outcome.ticks;
+						cell.seconds += batch.seconds[j * seeds + seed];
+					}
+					games += cell.games;
+					ticks += cell.ticks;
+					cells[key] = cell;
+					writeCheckpoint(checkpoint, key, cell);
+				}
+				std::cout << map_name << " / " << level_names[i] << " done" << std::endl;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		// a finished run has nothing left to resume
+		checkpoint.close();
+		std::remove(checkpoint_path.c_str());
+
+		printMatrix(map_names, level_names, cells);
+		std::cout << std::endl << "Cells resumed from " << checkpoint_path << ": " << resumed
+			<< ", games played: " << games << ", ticks: " << ticks << std::endl
+			<< "Time: " << elapsed.count() << " s on " << std::max(1U, std::thread::hardware_concurrency())
+			<< " threads, " << ticks / std::max(elapsed.count(), 1e-9) / 1e6 << " million ticks per second"
+			<< std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Difficulty matrix: every valid map against every valid level, played with a few
+// reference layouts over seeded headless games on all cores. Finished cells are
+// appended to a checkpoint file, so an interrupted run resumes where it stopped. The file
+// begins with the seeds, the budget and a hash of the data files, and it is started
+// afresh when any of them changed; a finished run removes it.
+// Usage: matrix [<seeds> [<budget> [<checkpoint file>]]]
+
+int runMatrix(int argc, char* argv[]);
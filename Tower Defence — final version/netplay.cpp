@@ -0,0 +1,444 @@
+#include "netplay.h"
+#include "arguments.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+	// commands of one tick are carried out host's first, each player's in the order given
+	bool before(const NetCommand& left, const NetCommand& right)
+	{
+		return left.tick < right.tick or (left.tick == right.tick and left.player < right.player);
+	}
+
+	void writeCommand(sf::Packet& packet, const NetCommand& entry)
+	{
+		// the same codes as in replays: 0 starts a wave, the defence type plus 2 places one
+		const Command& command = entry.command;
+		packet << static_cast<sf::Uint64>(entry.tick);
+		if (command.kind == Command::Kind::Start)
+			packet << static_cast<sf::Uint8>(0);
+		else
+			packet << static_cast<sf::Uint8>(static_cast<int>(command.defence) + 2)
+				<< static_cast<sf::Int32>(command.position.x) << static_cast<sf::Int32>(command.position.y);
+	}
+
+	void readCommand(sf::Packet& packet, NetCommand& entry)
+	{
+		sf::Uint64 tick = 0;
+		sf::Uint8 kind = 0;
+		packet >> tick >> kind;
+		entry.tick = tick;
+		if (kind == 0)
+			entry.command.kind = Command::Kind::Start;
+		else if (kind < 2 or kind >= DEFENCES_NUMBER + 2)
+			throw Error(Problem::NetworkError);
+		else
+		{
+			sf::Int32 x = 0, y = 0;
+			packet >> x >> y;
+			entry.command.kind = Command::Kind::Place;
+			entry.command.defence = static_cast<DefenceType>(kind - 2);
+			entry.command.position = { x, y };
+		}
+	}
+}
+
+std::uint64_t hashGameData(const std::string& map_name, const std::string& level_name)
+{
+	Manager& manager_ref = Manager::getInstance();
+	std::uint64_t hash = hashFile(manager_ref.getMapPath(map_name));
+	hash = hashValue(hash, hashFile(manager_ref.getLevelPath(level_name)));
+	hash = hashValue(hash, hashFile(std::filesystem::path(ENTITIES_DIR) / ENTITIES_SOURCE));
+	return hashValue(hash, hashFile(std::filesystem::path(DEFENCES_DIR) / DEFENCES_SOURCE));
+}
+
+Session::Session()
+{
+	m_state_ticks.fill(UINT64_MAX);
+}
+
+void Session::host(unsigned short port, const Hello& hello, const std::function<bool()>& waiting)
+{
+	sf::TcpListener listener;
+	if (listener.listen(port) != sf::Socket::Done)
+		throw Error(Problem::NetworkError);
+	listener.setBlocking(false);
+	while (listener.accept(m_socket) != sf::Socket::Done)
+	{
+		if (not waiting())
+			throw Error(Problem::Interrupt);
+	}
+	m_player = 0;
+	m_connected = true;
+	sf::Packet packet;
+	packet << static_cast<sf::Uint32>(NETPLAY_MAGIC) << static_cast<sf::Uint32>(NETPLAY_VERSION)
+		<< hello.map_name << hello.level_name
+		<< static_cast<sf::Uint64>(hello.seed) << static_cast<sf::Uint64>(hello.data_hash);
+	m_socket.setBlocking(true);
+	if (m_socket.send(packet) != sf::Socket::Done)
+		throw Error(Problem::NetworkError);
+}
+
+Hello Session::join(const std::string& address, unsigned short port)
+{
+	sf::IpAddress remote(address);
+	if (remote == sf::IpAddress::None
+		or m_socket.connect(remote, port, sf::seconds(static_cast<float>(NETPLAY_TIMEOUT))) != sf::Socket::Done)
+		throw Error(Problem::NetworkError);
+	m_player = 1;
+	m_connected = true;
+
+	// the host sends the hello as soon as it accepts, so a silent peer is not a host
+	m_socket.setBlocking(false);
+	sf::Packet packet;
+	Clock::time_point deadline = Clock::now() + std::chrono::seconds(NETPLAY_TIMEOUT);
+	while (true)
+	{
+		sf::Socket::Status status = m_socket.receive(packet);
+		if (status == sf::Socket::Done)
+			break;
+		if (status != sf::Socket::NotReady or Clock::now() > deadline)
+			throw Error(Problem::NetworkError);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	sf::Uint32 magic = 0, version = 0;
+	sf::Uint64 seed = 0, data_hash = 0;
+	Hello hello;
+	packet >> magic >> version >> hello.map_name >> hello.level_name >> seed >> data_hash;
+	if (not packet or magic != NETPLAY_MAGIC or version != NETPLAY_VERSION)
+		throw Error(Problem::NetworkError);
+	hello.seed = seed;
+	hello.data_hash = data_hash;
+	if (hello.data_hash != hashGameData(hello.map_name, hello.level_name))
+		throw Error(Problem::Desync);
+	return hello;
+}
+
+void Session::start(Simulation& simulation)
+{
+	m_simulation = &simulation;
+	m_socket.setBlocking(false);
+}
+
+void Session::setLag(std::chrono::milliseconds lag)
+{
+	m_lag = lag;
+}
+
+void Session::insert(const NetCommand& command)
+{
+	m_commands.insert(std::upper_bound(m_commands.begin(), m_commands.end(), command, before), command);
+}
+
+void Session::give(const Command& command)
+{
+	NetCommand entry{ m_simulation->getTick() + INPUT_DELAY, m_player, command };
+	insert(entry);
+	m_given.push_back(entry);
+}
+
+void Session::send()
+{
+	// a frame tells the other player up to which tick this one's commands are all known,
+	// with the commands and checksums that are new since the last frame
+	std::uint64_t frontier = m_simulation->getTick() + INPUT_DELAY;
+	if (frontier != m_sent_frontier or not m_given.empty() or not m_checks_to_send.empty())
+	{
+		Outgoing& outgoing = m_outgoing.emplace_back();
+		outgoing.due = Clock::now() + m_lag;
+		sf::Packet& packet = outgoing.packet;
+		packet << static_cast<sf::Uint64>(frontier) << static_cast<sf::Uint32>(m_given.size());
+		for (const NetCommand& entry : m_given)
+			writeCommand(packet, entry);
+		packet << static_cast<sf::Uint32>(m_checks_to_send.size());
+		for (const auto& [tick, hash] : m_checks_to_send)
+			packet << static_cast<sf::Uint64>(tick) << static_cast<sf::Uint64>(hash);
+		m_sent_frontier = frontier;
+		m_given.clear();
+		m_checks_to_send.clear();
+	}
+	Clock::time_point now = Clock::now();
+	while (m_connected and not m_outgoing.empty() and m_outgoing.front().due <= now)
+	{
+		// a partly sent packet remembers how far it got and is sent again next time
+		sf::Socket::Status status = m_socket.send(m_outgoing.front().packet);
+		if (status == sf::Socket::Done)
+			m_outgoing.pop_front();
+		else if (status == sf::Socket::Partial or status == sf::Socket::NotReady)
+			break;
+		else
+			m_connected = false;
+	}
+}
+
+void Session::receive()
+{
+	while (m_connected)
+	{
+		sf::Socket::Status status = m_socket.receive(m_incoming);
+		if (status == sf::Socket::Done)
+			read(m_incoming);
+		else if (status == sf::Socket::NotReady or status == sf::Socket::Partial)
+			break;
+		else
+			m_connected = false;
+	}
+}
+
+void Session::read(sf::Packet& packet)
+{
+	sf::Uint64 frontier = 0;
+	sf::Uint32 count = 0;
+	packet >> frontier >> count;
+	for (sf::Uint32 i = 0; i < count and packet; ++i)
+	{
+		NetCommand entry;
+		entry.player = 1 - m_player;
+		readCommand(packet, entry);
+		// the other player promised to give nothing before its frontier
+		if (entry.tick < m_remote_frontier)
+			throw Error(Problem::NetworkError);
+		insert(entry);
+		if (entry.tick < m_simulation->getTick())
+			m_rewind = std::min(m_rewind, entry.tick);
+	}
+	packet >> count;
+	for (sf::Uint32 i = 0; i < count and packet; ++i)
+	{
+		sf::Uint64 tick = 0, hash = 0;
+		packet >> tick >> hash;
+		auto local = m_local_checks.find(tick);
+		if (local == m_local_checks.end())
+			m_remote_checks[tick] = hash;
+		else
+		{
+			compare(local->second, hash);
+			m_local_checks.erase(local);
+		}
+	}
+	if (not packet)
+		throw Error(Problem::NetworkError);
+	m_remote_frontier = std::max<std::uint64_t>(m_remote_frontier, frontier);
+}
+
+void Session::compare(std::uint64_t local, std::uint64_t remote)
+{
+	if (local != remote)
+		throw Error(Problem::Desync);
+	++m_stats.checks;
+}
+
+bool Session::rewind()
+{
+	if (m_rewind == UINT64_MAX)
+		return false;
+	Clock::time_point start = Clock::now();
+	std::uint64_t present = m_simulation->getTick();
+	std::uint64_t slot = m_rewind % ROLLBACK_WINDOW;
+	// the other player never gets so far behind that the state is gone, unless it cheats
+	if (m_state_ticks[slot] != m_rewind)
+		throw Error(Problem::Desync);
+	ByteReader reader(m_states[slot].getBytes());
+	m_simulation->read(reader);
+	m_rewind = UINT64_MAX;
+	while (m_simulation->getTick() < present and not m_simulation->isOver())
+	{
+		advance();
+		++m_stats.resimulated;
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	++m_stats.rollbacks;
+	m_stats.rollback_time += elapsed;
+	m_stats.worst_rollback = std::max(m_stats.worst_rollback, elapsed);
+	return true;
+}
+
+void Session::check()
+{
+	// the state before a tick is final once every command before it is known
+	std::uint64_t settled = std::min(m_remote_frontier, m_simulation->getTick());
+	for (; m_next_check < settled; m_next_check += NETPLAY_CHECK_PERIOD)
+	{
+		std::uint64_t slot = m_next_check % ROLLBACK_WINDOW;
+		if (m_state_ticks[slot] != m_next_check)
+			continue;
+		const std::vector<std::uint8_t>& state = m_states[slot].getBytes();
+		std::uint64_t hash = hashBytes(state.data(), state.size());
+		m_checks_to_send.emplace_back(m_next_check, hash);
+		auto remote = m_remote_checks.find(m_next_check);
+		if (remote == m_remote_checks.end())
+			m_local_checks[m_next_check] = hash;
+		else
+		{
+			compare(hash, remote->second);
+			m_remote_checks.erase(remote);
+		}
+	}
+	// commands before that are carried out and will never be again
+	auto end = std::lower_bound(m_commands.begin(), m_commands.end(), NetCommand{ settled, 0, {} }, before);
+	m_commands.erase(m_commands.begin(), end);
+}
+
+bool Session::exchange()
+{
+	receive();
+	bool rolled_back = rewind();
+	check();
+	send();
+	if (not m_connected and not isDecided())
+		throw Error(Problem::NetworkError);
+	return rolled_back;
+}
+
+bool Session::canAdvance() const
+{
+	// running a tick must leave the state of the other player's frontier in the window
+	return not m_simulation->isOver() and m_simulation->getTick() < m_remote_frontier + ROLLBACK_WINDOW;
+}
+
+void Session::advance()
+{
+	std::uint64_t tick = m_simulation->getTick();
+	std::uint64_t slot = tick % ROLLBACK_WINDOW;
+	m_states[slot].clear();
+	m_simulation->write(m_states[slot]);
+	m_state_ticks[slot] = tick;
+	auto entry = std::lower_bound(m_commands.begin(), m_commands.end(), NetCommand{ tick, 0, {} }, before);
+	for (; entry != m_commands.end() and entry->tick == tick; ++entry)
+		m_simulation->execute(entry->command);
+	m_simulation->tick();
+}
+
+bool Session::isDecided() const
+{
+	// the other player's frontier shows it has got to the end as well, and it has to learn
+	// this player's last frontier before either of them may leave
+	return m_simulation->isOver() and m_simulation->getTick() + INPUT_DELAY <= m_remote_frontier
+		and (m_outgoing.empty() or not m_connected);
+}
+
+bool Session::isConnected() const
+{
+	return m_connected;
+}
+
+int Session::getPlayer() const
+{
+	return m_player;
+}
+
+const NetplayStats& Session::getStats() const
+{
+	return m_stats;
+}
+
+int runCoop(int argc, char* argv[])
+{
+	bool hosting = argc > 2 and std::string(argv[2]) == "host";
+	bool joining = argc > 2 and std::string(argv[2]) == "join";
+	int options = hosting ? 6 : 5;
+	if ((not hosting and not joining) or argc < options)
+	{
+		std::cout << "Usage: coop host <port> \"<map name>\" \"<level name>\" [<speed> [<lag in ms>]]" << std::endl
+			<< "       coop join <address> <port> [<speed> [<lag in ms>]]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		Session session;
+		Hello hello;
+		if (hosting)
+		{
+			hello.map_name = argv[4];
+			hello.level_name = argv[5];
+			hello.seed = static_cast<std::uint64_t>(std::time(0));
+			hello.data_hash = hashGameData(hello.map_name, hello.level_name);
+			std::cout << "Waiting for the other player on port " << argv[3] << "..." << std::endl;
+			session.host(parsePort(argv[3]), hello, []()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					return true;
+				});
+		}
+		else
+			hello = session.join(argv[3], parsePort(argv[4]));
+		manager_ref.loadMap(hello.map_name);
+		Level level;
+		manager_ref.loadLevel(hello.level_name, level);
+		Simulation simulation(level, nullptr, hello.seed);
+		session.start(simulation);
+		int speed = argc > options ? std::max(1, parseInt(argv[options])) : 1;
+		if (argc > options + 1)
+			session.setLag(std::chrono::milliseconds(parseInt(argv[options + 1])));
+
+		// each player starts waves and buys defences at random moments, on spots of its own
+		using Clock = std::chrono::steady_clock;
+		const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::nanoseconds(1000000000LL / (FREQUENCY * speed)));
+		Random random(hello.seed + 1 + session.getPlayer());
+		std::uint64_t next_move = 0, waits = 0;
+		bool waiting = false;
+		Clock::time_point next = Clock::now(), start = next;
+		while (not session.isDecided())
+		{
+			if (Clock::now() >= next)
+			{
+				if (session.canAdvance())
+				{
+					if (simulation.getTick() >= next_move)
+					{
+						Command command;
+						if (not simulation.isFighting() and random.below(2) == 0)
+							command.kind = Command::Kind::Start;
+						else
+						{
+							command.kind = Command::Kind::Place;
+							command.defence = static_cast<DefenceType>(random.below(DEFENCES_NUMBER));
+							command.position = { random.below(static_cast<int>(WORLD_WIDTH)),
+								random.below(static_cast<int>(WORLD_HEIGHT)) };
+						}
+						session.give(command);
+						next_move = simulation.getTick() + 30 + random.below(300);
+					}
+					session.advance();
+					next += period;
+					waiting = false;
+				}
+				else if (not waiting and not simulation.isOver())
+				{
+					++waits;
+					waiting = true;
+				}
+			}
+			session.exchange();
+			std::this_thread::sleep_until(std::min(next, Clock::now() + std::chrono::milliseconds(1)));
+		}
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+
+		const NetplayStats& stats = session.getStats();
+		std::cout << "Player " << session.getPlayer() + 1 << ": "
+			<< (simulation.getResult() == Result::Victory ? "victory" : "failure") << " after "
+			<< simulation.getTick() << " ticks in " << elapsed.count() << " s, health " << simulation.getHealth()
+			<< ", money " << simulation.getMoney() << ", " << simulation.getDefences().size() << " defences, checksum "
+			<< std::hex << simulation.checksum() << std::dec << std::endl
+			<< stats.rollbacks << " rollbacks, " << stats.resimulated << " ticks simulated again, worst rollback "
+			<< stats.worst_rollback * 1e3 << " ms, mean "
+			<< (stats.rollbacks > 0 ? stats.rollback_time / stats.rollbacks * 1e3 : 0.) << " ms; "
+			<< waits << " waits for the other player; " << stats.checks << " checksums agreed" << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
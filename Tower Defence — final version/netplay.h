@@ -0,0 +1,133 @@
+#pragma once
+#include "binary.h"
+#include "simulation.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <SFML/Network.hpp>
+
+// Co-op over the network: two players share one game, each placing defences from their
+// own process. Both run the same seeded simulation in lockstep. A command is carried out
+// INPUT_DELAY ticks after it was given, which is usually enough for it to reach the other
+// player in time. When one arrives late, the game goes back to the state kept from before
+// its tick and runs the ticks since then again, in the same frame. The states of the last
+// ROLLBACK_WINDOW ticks are kept (a few microseconds each, through Simulation::write);
+// a player who would get further ahead of the other waits. Commands of the same tick are
+// carried out host's first, so both games take the same course, and the players compare
+// checksums of the state every NETPLAY_CHECK_PERIOD ticks to find out if they do not.
+// Usage: coop host <port> "<map name>" "<level name>" [<speed> [<lag in ms>]]
+//        coop join <address> <port> [<speed> [<lag in ms>]]
+
+const std::uint32_t NETPLAY_MAGIC = 0x50434454; // "TDCP"
+const int NETPLAY_VERSION = 1;
+const unsigned short NETPLAY_PORT = 53017;
+const int NETPLAY_TIMEOUT = 10; // seconds to connect and shake hands
+const std::uint64_t INPUT_DELAY = 3; // ticks
+const std::uint64_t ROLLBACK_WINDOW = 30; // ticks
+const std::uint64_t NETPLAY_CHECK_PERIOD = 60; // ticks
+
+// What the host tells the player who joins: everything needed to start the same game.
+struct Hello
+{
+	std::string map_name;
+	std::string level_name;
+	std::uint64_t seed = 1;
+	std::uint64_t data_hash = 0; // of the map, level, entities and defences files
+};
+
+struct NetCommand
+{
+	std::uint64_t tick = 0; // carried out before this tick of the simulation runs
+	int player = 0; // 0 hosts, 1 joins
+	Command command;
+};
+
+struct NetplayStats
+{
+	int rollbacks = 0;
+	std::uint64_t resimulated = 0; // ticks run again
+	double worst_rollback = 0.; // seconds
+	double rollback_time = 0.; // seconds, in all
+	int checks = 0; // checksums that agreed
+};
+
+std::uint64_t hashGameData(const std::string& map_name, const std::string& level_name);
+
+class Session
+{
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	struct Outgoing
+	{
+		Clock::time_point due;
+		sf::Packet packet;
+	};
+
+	// connection //
+
+	int m_player = 0;
+	sf::TcpSocket m_socket;
+	std::deque<Outgoing> m_outgoing; // frames not fully sent yet
+	sf::Packet m_incoming;
+	bool m_connected = false;
+	Clock::duration m_lag = Clock::duration::zero(); // added to every frame sent, for testing
+
+	// timeline //
+
+	Simulation* m_simulation = nullptr;
+	std::array<ByteWriter, ROLLBACK_WINDOW> m_states; // before tick t, at t % ROLLBACK_WINDOW
+	std::array<std::uint64_t, ROLLBACK_WINDOW> m_state_ticks;
+	std::vector<NetCommand> m_commands; // in the order they are carried out
+	std::vector<NetCommand> m_given; // this player's, not sent yet
+	std::uint64_t m_remote_frontier = INPUT_DELAY; // all the other player's commands before it are here
+	std::uint64_t m_sent_frontier = 0;
+	std::uint64_t m_rewind = UINT64_MAX; // the earliest tick that has to run again
+
+	// checks //
+
+	std::uint64_t m_next_check = NETPLAY_CHECK_PERIOD;
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> m_checks_to_send;
+	std::map<std::uint64_t, std::uint64_t> m_local_checks; // not yet compared, by tick
+	std::map<std::uint64_t, std::uint64_t> m_remote_checks;
+
+	NetplayStats m_stats;
+
+	void insert(const NetCommand& command);
+	void send();
+	void receive();
+	void read(sf::Packet& packet);
+	void compare(std::uint64_t local, std::uint64_t remote); // throws when the games differ
+	void check();
+	bool rewind(); // true when it did
+
+public:
+
+	Session();
+	Session(const Session&) = delete;
+	Session& operator=(const Session&) = delete;
+
+	// waiting is called while nobody has joined; returning false gives up with Problem::Interrupt
+	void host(unsigned short port, const Hello& hello, const std::function<bool()>& waiting);
+	Hello join(const std::string& address, unsigned short port); // checks the data files, too
+	void start(Simulation& simulation);
+	void setLag(std::chrono::milliseconds lag);
+
+	void give(const Command& command); // from this player
+	bool exchange(); // sends and receives; true when a late command rolled the game back
+	bool canAdvance() const;
+	void advance(); // runs one tick
+	bool isDecided() const; // the game is over and no command can change that any more
+	bool isConnected() const;
+
+	int getPlayer() const;
+	const NetplayStats& getStats() const;
+};
+
+int runCoop(int argc, char* argv[]);
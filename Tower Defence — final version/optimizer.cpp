@@ -0,0 +1,326 @@
+#include "optimizer.h"
+#include "arguments.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include "random.h"
+#include "workers.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+const int OPTIMIZER_GRID = 20; // layouts are kept on a grid, so that near copies are cached as one
+const int OPTIMIZER_ELITE = 4;
+const int OPTIMIZER_TOURNAMENT = 3;
+const int OPTIMIZER_SHIFT = 3; // grid cells a mutation moves a defence by at most
+const int OPTIMIZER_TICKS_SCALE = 10000;
+const double OPTIMIZER_MAX_SCORE = 2. * INITIAL_HEALTH;
+
+namespace
+{
+	struct Score
+	{
+		double fitness = 0.;
+		int games = 0; // fewer than the seeds when the layout was cut off early
+		int victories = 0;
+		double health = 0.;
+	};
+
+	struct Individual
+	{
+		Layout layout;
+		Score score;
+	};
+
+	// A victory scores above any failure and more with more health left;
+	// a failure scores by how long it held out.
+	double scoreGame(const Outcome& outcome)
+	{
+		if (outcome.result == Result::Victory)
+			return INITIAL_HEALTH + outcome.health;
+		double ticks = static_cast<double>(outcome.ticks);
+		return INITIAL_HEALTH * ticks / (ticks + OPTIMIZER_TICKS_SCALE);
+	}
+
+	std::string layoutKey(const Layout& layout)
+	{
+		std::string key;
+		for (const Placement& placement : layout)
+		{
+			key += static_cast<char>(placement.type);
+			key.append(reinterpret_cast<const char*>(&placement.position.x), sizeof(int));
+			key.append(reinterpret_cast<const char*>(&placement.position.y), sizeof(int));
+		}
+		return key;
+	}
+
+	class Optimizer
+	{
+	private:
+
+		const Level& m_level;
+		int m_budget;
+		int m_seeds;
+		Random m_random;
+		Workers m_workers;
+		std::unordered_map<std::string, Score> m_cache;
+		int m_cut_off = 0;
+
+		sf::Vector2i randomPosition()
+		{
+			int columns = static_cast<int>(WORLD_WIDTH) / OPTIMIZER_GRID;
+			int rows = static_cast<int>(WORLD_HEIGHT) / OPTIMIZER_GRID;
+			return sf::Vector2i((m_random.below(columns) * 2 + 1) * OPTIMIZER_GRID / 2,
+				(m_random.below(rows) * 2 + 1) * OPTIMIZER_GRID / 2);
+		}
+
+		bool addRandomDefence(Layout& layout)
+		{
+			Manager& manager_ref = Manager::getInstance();
+			int money = m_budget - layoutCost(layout);
+			std::vector<DefenceType> affordable;
+			for (int i = 0; i < DEFENCES_NUMBER; ++i)
+			{
+				if (manager_ref.getDefenceRecord(static_cast<DefenceType>(i)).cost <= money)
+					affordable.push_back(static_cast<DefenceType>(i));
+			}
+			if (affordable.empty())
+				return false;
+			layout.push_back({ affordable[m_random.below(static_cast<int>(affordable.size()))], randomPosition() });
+			return true;
+		}
+
+		// drops random defences until the layout is affordable, then orders it so that
+		// equal layouts are equal element by element
+		void repair(Layout& layout)
+		{
+			while (layoutCost(layout) > m_budget)
+				layout.erase(layout.begin() + m_random.below(static_cast<int>(layout.size())));
+			std::sort(layout.begin(), layout.end(), [](const Placement& lhs, const Placement& rhs)
+				{
+					return std::tie(lhs.type, lhs.position.x, lhs.position.y)
+						< std::tie(rhs.type, rhs.position.x, rhs.position.y);
+				});
+		}
+
+		Layout randomLayout()
+		{
+			Layout layout;
+			while (addRandomDefence(layout));
+			repair(layout);
+			return layout;
+		}
+
+		Layout crossover(const Layout& first, const Layout& second)
+		{
+			Layout child;
+			for (const Placement& placement : first)
+			{
+				if (m_random.below(2) == 0)
+					child.push_back(placement);
+			}
+			for (const Placement& placement : second)
+			{
+				if (m_random.below(2) == 0)
+					child.push_back(placement);
+			}
+			for (int i = static_cast<int>(child.size()) - 1; i > 0; --i)
+				std::swap(child[i], child[m_random.below(i + 1)]);
+			repair(child);
+			return child;
+		}
+
+		void mutate(Layout& layout)
+		{
+			int width = static_cast<int>(WORLD_WIDTH), height = static_cast<int>(WORLD_HEIGHT);
+			switch (layout.empty() ? 3 : m_random.below(4))
+			{
+			case 0:
+			{
+				sf::Vector2i& position = layout[m_random.below(static_cast<int>(layout.size()))].position;
+				position.x += (m_random.below(2 * OPTIMIZER_SHIFT + 1) - OPTIMIZER_SHIFT) * OPTIMIZER_GRID;
+				position.y += (m_random.below(2 * OPTIMIZER_SHIFT + 1) - OPTIMIZER_SHIFT) * OPTIMIZER_GRID;
+				position.x = std::clamp(position.x, OPTIMIZER_GRID / 2, width - OPTIMIZER_GRID / 2);
+				position.y = std::clamp(position.y, OPTIMIZER_GRID / 2, height - OPTIMIZER_GRID / 2);
+				break;
+			}
+			case 1:
+				layout[m_random.below(static_cast<int>(layout.size()))].type =
+					static_cast<DefenceType>(m_random.below(DEFENCES_NUMBER));
+				break;
+			case 2:
+				layout.erase(layout.begin() + m_random.below(static_cast<int>(layout.size())));
+				break;
+			default:
+				addRandomDefence(layout);
+			}
+			while (addRandomDefence(layout) and m_random.below(2) == 0);
+			repair(layout);
+		}
+
+		const Individual& tournament(const std::vector<Individual>& population)
+		{
+			const Individual* best = &population[m_random.below(static_cast<int>(population.size()))];
+			for (int i = 1; i < OPTIMIZER_TOURNAMENT; ++i)
+			{
+				const Individual& rival = population[m_random.below(static_cast<int>(population.size()))];
+				if (rival.score.fitness > best->score.fitness)
+					best = &rival;
+			}
+			return *best;
+		}
+
+		// Scores every layout not seen before, one layout per task. A layout is cut off
+		// as soon as even winning all its remaining games with full health could not
+		// lift it over the threshold.
+		void evaluate(std::vector<Individual>& population, double threshold)
+		{
+			struct Batch
+			{
+				Optimizer* optimizer;
+				std::vector<Individual*> pending;
+				double threshold;
+			};
+			Batch batch{ this, {}, threshold };
+			for (Individual& individual : population)
+			{
+				auto it = m_cache.find(layoutKey(individual.layout));
+				if (it != m_cache.end())
+					individual.score = it->second;
+				else
+					batch.pending.push_back(&individual);
+			}
+			auto score = [](void* context, int task)
+			{
+				Batch& batch = *static_cast<Batch*>(context);
+				Individual& individual = *batch.pending[task];
+				int seeds = batch.optimizer->m_seeds;
+				Score& score = individual.score;
+				score = Score();
+				double total = 0., health = 0.;
+				for (int seed = 1; seed <= seeds; ++seed)
+				{
+					Outcome outcome = playHeadless(batch.optimizer->m_level, individual.layout,
+						batch.optimizer->m_budget, seed);
+					total += scoreGame(outcome);
+					++score.games;
+					if (outcome.result == Result::Victory)
+					{
+						++score.victories;
+						health += outcome.health;
+					}
+					if ((total + (seeds - seed) * OPTIMIZER_MAX_SCORE) / seeds < batch.threshold)
+					{
+						score.fitness = (total + (seeds - seed) * OPTIMIZER_MAX_SCORE) / seeds;
+						return;
+					}
+				}
+				score.fitness = total / seeds;
+				score.health = score.victories > 0 ? health / score.victories : 0.;
+			};
+			m_workers.run(static_cast<int>(batch.pending.size()), score, &batch);
+			for (Individual* individual : batch.pending)
+			{
+				if (individual->score.games < m_seeds)
+					++m_cut_off;
+				m_cache[layoutKey(individual->layout)] = individual->score;
+			}
+		}
+
+	public:
+
+		Optimizer(const Level& level, int budget, int seeds) :
+			m_level(level),
+			m_budget(budget),
+			m_seeds(seeds),
+			m_random(static_cast<std::uint64_t>(budget) * 7919 + seeds),
+			m_workers(std::max(1U, std::thread::hardware_concurrency()) - 1)
+		{
+		}
+
+		Individual run(int generations, int population_size)
+		{
+			auto by_fitness = [](const Individual& lhs, const Individual& rhs)
+			{
+				return lhs.score.fitness > rhs.score.fitness;
+			};
+			int elite = std::min(OPTIMIZER_ELITE, population_size);
+			std::vector<Individual> population(population_size);
+			for (Individual& individual : population)
+				individual.layout = randomLayout();
+			evaluate(population, 0.);
+			std::sort(population.begin(), population.end(), by_fitness);
+			for (int generation = 1; generation <= generations; ++generation)
+			{
+				auto start = std::chrono::steady_clock::now();
+				std::vector<Individual> next(population.begin(), population.begin() + elite);
+				while (next.size() < population.size())
+				{
+					Individual child;
+					child.layout = crossover(tournament(population).layout, tournament(population).layout);
+					mutate(child.layout);
+					next.push_back(child);
+				}
+				evaluate(next, next[elite - 1].score.fitness);
+				population = std::move(next);
+				std::sort(population.begin(), population.end(), by_fitness);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+				const Score& best = population.front().score;
+				std::cout << "Generation " << generation << ": best " << best.fitness
+					<< " (" << best.victories << "/" << best.games << " won), "
+					<< m_cache.size() << " layouts evaluated, " << m_cut_off << " cut off early, "
+					<< elapsed.count() << " s" << std::endl;
+			}
+			return population.front();
+		}
+	};
+}
+
+int runOptimizer(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		std::cout << "Usage: optimize \"<map name>\" \"<level name>\" <budget> "
+			"[<generations> [<population> [<seeds>]]]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::string map_name = argv[2], level_name = argv[3];
+		int budget = parseInt(argv[4]);
+		int generations = argc > 5 ? parseInt(argv[5]) : 20;
+		int population = argc > 6 ? std::max(2, parseInt(argv[6])) : 32;
+		int seeds = argc > 7 ? std::max(1, parseInt(argv[7])) : 8;
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		manager_ref.loadMap(map_name);
+		Level level;
+		manager_ref.loadLevel(level_name, level);
+
+		Optimizer optimizer(level, budget, seeds);
+		Individual best = optimizer.run(generations, population);
+
+		std::cout << std::endl << "Best layout, cost " << layoutCost(best.layout) << " of " << budget
+			<< ", won " << best.score.victories << " of " << best.score.games
+			<< " games with " << best.score.health << " health left on average:" << std::endl;
+		for (const Placement& placement : best.layout)
+		{
+			std::cout << "\t" << LABELS[static_cast<int>(placement.type)] << " "
+				<< placement.position.x << " " << placement.position.y << std::endl;
+		}
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
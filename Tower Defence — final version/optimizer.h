@@ -0,0 +1,7 @@
+#pragma once
+
+// Genetic search for a defence layout: populations of layouts that fit in a money budget
+// are scored by seeded headless games on all cores, and the best layout is printed.
+// Usage: optimize "<map name>" "<level name>" <budget> [<generations> [<population> [<seeds>]]]
+
+int runOptimizer(int argc, char* argv[]);
@@ -0,0 +1,129 @@
+#include "overlay.h"
+#include "allocations.h"
+#include "manager.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+Overlay::Overlay()
+{
+	m_background.setFillColor(OVERLAY_BACKGROUND);
+	m_labels.setFillColor(OVERLAY_COLOR);
+	m_values.setFillColor(OVERLAY_COLOR);
+	m_labels.setString("FPS\nframe\ntick: spawn\ntick: attack\ntick: move\nrender\nentities\ndefences\n"
+		"range tests/round\nhits/round\ndraw calls\nallocations/frame\nmemory");
+}
+
+void Overlay::setFont(const sf::Font& font)
+{
+	unsigned int size = static_cast<unsigned int>(.25f * TEXT_SIZE);
+	m_labels.setFont(font);
+	m_labels.setCharacterSize(size);
+	m_values.setFont(font);
+	m_values.setCharacterSize(size);
+}
+
+void Overlay::setCorner(float right, float top)
+{
+	m_right = right;
+	m_top = top;
+}
+
+void Overlay::toggle()
+{
+	m_shown = not m_shown;
+	// a fresh window, laid out with the first frame
+	m_count = 0;
+	m_laid_out = std::chrono::steady_clock::time_point();
+}
+
+bool Overlay::isShown() const
+{
+	return m_shown;
+}
+
+void Overlay::observe(const FrameRecord& frame, const SimulationStats& stats)
+{
+	// the statistics start over with every new simulation, as after loading a quicksave
+	if (m_count > 0 and stats.ticks < m_samples[(m_next + OVERLAY_FRAMES - 1) % OVERLAY_FRAMES].stats.ticks)
+		m_count = 0;
+	m_samples[m_next] = Sample{ frame, stats };
+	m_next = (m_next + 1) % OVERLAY_FRAMES;
+	m_count = std::min(m_count + 1, OVERLAY_FRAMES);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<float>(now - m_laid_out).count() >= OVERLAY_REFRESH)
+	{
+		layOut();
+		m_laid_out = now;
+	}
+}
+
+void Overlay::layOut()
+{
+	double frame_time = 0., render_time = 0., draw_calls = 0., allocations = 0.;
+	float worst_frame = 0.f;
+	for (int i = 0; i < m_count; ++i)
+	{
+		const FrameRecord& frame = m_samples[(m_next + OVERLAY_FRAMES - 1 - i) % OVERLAY_FRAMES].frame;
+		frame_time += frame.total;
+		worst_frame = std::max(worst_frame, frame.total);
+		render_time += frame.world + frame.sprites + frame.hud + frame.display;
+		draw_calls += frame.draw_calls;
+		allocations += static_cast<double>(frame.allocations);
+	}
+	const Sample& first = m_samples[(m_next + OVERLAY_FRAMES - m_count) % OVERLAY_FRAMES];
+	const Sample& last = m_samples[(m_next + OVERLAY_FRAMES - 1) % OVERLAY_FRAMES];
+	std::uint64_t ticks = last.stats.ticks - first.stats.ticks;
+	std::uint64_t rounds = last.stats.attack_rounds - first.stats.attack_rounds;
+
+	std::ostringstream values;
+	values << std::fixed << std::setprecision(1);
+	auto per_tick = [&values, ticks](std::int64_t from, std::int64_t to)
+	{
+		if (ticks == 0)
+			values << "-\n";
+		else
+			values << std::setprecision(2) << (to - from) * 1e-3 / ticks << " us\n" << std::setprecision(1);
+	};
+	auto per_round = [&values, rounds](std::uint64_t from, std::uint64_t to)
+	{
+		if (rounds == 0)
+			values << "-\n";
+		else
+			values << static_cast<double>(to - from) / rounds << '\n';
+	};
+	values << (frame_time > 0. ? 1000. * m_count / frame_time : 0.) << '\n'
+		<< frame_time / m_count << " ms (worst " << worst_frame << ")\n";
+	per_tick(first.stats.spawn_time, last.stats.spawn_time);
+	per_tick(first.stats.attack_time, last.stats.attack_time);
+	per_tick(first.stats.move_time, last.stats.move_time);
+	values << render_time / m_count << " ms\n"
+		<< last.frame.entities << '\n'
+		<< last.frame.defences << '\n';
+	per_round(first.stats.range_tests, last.stats.range_tests);
+	per_round(first.stats.hits, last.stats.hits);
+	values << draw_calls / m_count << '\n'
+		<< allocations / m_count << '\n'
+		<< residentBytes() / (1024. * 1024.) << " MB";
+	m_values.setString(values.str());
+
+	// the box only grows, so that it does not shake as the numbers change
+	float gap = .2f * TEXT_SIZE;
+	sf::FloatRect labels = m_labels.getLocalBounds(), numbers = m_values.getLocalBounds();
+	sf::Vector2f size(std::max(m_background.getSize().x, labels.width + numbers.width + 3.f * gap),
+		std::max(labels.height, numbers.height) + 2.f * gap);
+	m_background.setSize(size);
+	m_background.setPosition(m_right - size.x, m_top);
+	m_labels.setPosition(m_right - size.x + gap, m_top + .5f * gap);
+	m_values.setPosition(m_right - size.x + labels.width + 2.f * gap, m_top + .5f * gap);
+}
+
+int Overlay::drawYourself(sf::RenderWindow& window)
+{
+	if (not m_shown or m_count == 0)
+		return 0;
+	window.draw(m_background);
+	window.draw(m_labels);
+	window.draw(m_values);
+	return 3;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "hitch.h"
+#include "simulation.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <SFML/Audio.hpp>
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+#include <SFML/System.hpp>
+#include <SFML/Window.hpp>
+
+// Performance overlay, toggled with F3 and drawn at the top right of the world, next to the
+// health and money bars. It takes every frame the hitch recorder finished and the statistics
+// of the snapshot drawn in it, and shows averages over the last OVERLAY_FRAMES frames. The
+// numbers are laid out again only every OVERLAY_REFRESH seconds and the labels never, so the
+// glyphs are cached in between and the overlay costs three draw calls a frame.
+
+const int OVERLAY_FRAMES = 120; // two seconds at 60 frames a second
+const float OVERLAY_REFRESH = .5f; // seconds
+const sf::Color OVERLAY_COLOR(0xff, 0xff, 0xff), OVERLAY_BACKGROUND(0x00, 0x00, 0x00, 0xa0);
+
+class Overlay
+{
+private:
+
+	struct Sample
+	{
+		FrameRecord frame;
+		SimulationStats stats;
+	};
+
+	std::array<Sample, OVERLAY_FRAMES> m_samples; // a ring
+	int m_count = 0;
+	int m_next = 0;
+	bool m_shown = false;
+	std::chrono::steady_clock::time_point m_laid_out;
+	sf::RectangleShape m_background;
+	sf::Text m_labels;
+	sf::Text m_values;
+	float m_right = 0.f;
+	float m_top = 0.f;
+
+	void layOut();
+
+public:
+
+	Overlay();
+
+	void setFont(const sf::Font& font);
+	void setCorner(float right, float top); // the top right one
+	void toggle();
+	bool isShown() const;
+
+	void observe(const FrameRecord& frame, const SimulationStats& stats);
+	int drawYourself(sf::RenderWindow& window); // returns the number of draw calls
+};
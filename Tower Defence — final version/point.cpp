@@ -1,11 +1,10 @@
 #include "error.h"
 #include "point.h"
 #include <cmath>
-#include <cstdlib>
 #include <numbers>
 
 Point::Point(PointType type, const sf::Vector2f& position)
-	: m_type(type), m_position(position)
+	: m_type(type), m_position(position), m_coords(toFixed(position))
 {
     switch (type)
     {
@@ -48,13 +47,6 @@ void Point::addNeighbour(int index, const sf::Vector2f& coords)
     m_neighbours.emplace_back(index, rectangle);
 }
 
-int Point::randomNeighbour()
-{
-    if (m_neighbours.empty())
-        throw Error(Problem::OutOfRange);
-    return m_neighbours[rand() % m_neighbours.size()].first;
-}
-
 PointType Point::getType() const
 {
     return m_type;
@@ -65,14 +57,21 @@ sf::Vector2f Point::getPosition() const
     return m_position;
 }
 
-void Point::drawLines(sf::RenderWindow& window)
+FixedVector Point::getCoords() const
+{
+    return m_coords;
+}
+
+int Point::drawLines(sf::RenderWindow& window)
 {
     for (auto it = m_neighbours.begin(); it != m_neighbours.end(); ++it)
         window.draw(it->second);
+    return static_cast<int>(m_neighbours.size());
 }
 
-void Point::drawCircle(sf::RenderWindow& window)
+int Point::drawCircle(sf::RenderWindow& window)
 {
     window.draw(m_circle);
+    return 1;
 }
 
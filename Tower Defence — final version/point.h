@@ -1,4 +1,5 @@
 #pragma once
+#include "fixed.h"
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #include <SFML/Network.hpp>
@@ -25,6 +26,7 @@ private:
 
 	PointType m_type;
 	sf::Vector2f m_position;
+	FixedVector m_coords;
 	sf::CircleShape m_circle;
 	std::vector <std::pair<int, sf::RectangleShape>> m_neighbours;
 
@@ -33,12 +35,12 @@ public:
 	Point(PointType type, const sf::Vector2f& position);
 	
 	void addNeighbour(int index, const sf::Vector2f& coords);
-	int randomNeighbour();
 
 	PointType getType() const;
 	sf::Vector2f getPosition() const;
+	FixedVector getCoords() const;
 
-	void drawLines(sf::RenderWindow& window);
-	void drawCircle(sf::RenderWindow& window);
+	int drawLines(sf::RenderWindow& window); // these return the number of draw calls
+	int drawCircle(sf::RenderWindow& window);
 };
 
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed-size object storage handed out in chunks and recycled through a free list,
+// so objects are constructed in place instead of being allocated one by one.
+
+const int POOL_CHUNK = 32;
+
+template <typename T>
+class Pool
+{
+private:
+
+	struct Slot
+	{
+		alignas(T) std::byte storage[sizeof(T)];
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> m_chunks;
+	std::vector<T*> m_free;
+	std::mutex m_mutex;
+
+	void grow()
+	{
+		m_chunks.emplace_back(std::make_unique<Slot[]>(POOL_CHUNK));
+		m_free.reserve(m_chunks.size() * POOL_CHUNK);
+		for (int i = POOL_CHUNK - 1; i >= 0; --i)
+			m_free.push_back(reinterpret_cast<T*>(m_chunks.back()[i].storage));
+	}
+
+public:
+
+	Pool() = default;
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	template <typename... Args>
+	T* make(Args&&... args)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_free.empty())
+			grow();
+		T* object = new (m_free.back()) T(std::forward<Args>(args)...);
+		m_free.pop_back();
+		return object;
+	}
+
+	void recycle(T* object)
+	{
+		if (object == nullptr)
+			return;
+		object->~T();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(object);
+	}
+};
@@ -0,0 +1,133 @@
+#include "profile.h"
+
+#if defined(PROFILING)
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Zone
+	{
+		const char* name;
+		std::int64_t begin;
+		std::int64_t end;
+	};
+
+	// written by its thread only; the count is published last, so the writer at exit
+	// reads whole zones while the thread goes on recording
+	struct ThreadLog
+	{
+		int id = 0;
+		std::atomic<const char*> name = nullptr;
+		std::atomic<std::size_t> count = 0;
+		std::atomic<std::uint64_t> dropped = 0;
+		std::array<std::atomic<Zone*>, PROFILE_CHUNKS> chunks{};
+	};
+
+	// never freed: threads may still record while the process exits
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<ThreadLog*> logs;
+	};
+
+	const Clock::time_point s_start = Clock::now();
+	thread_local ThreadLog* t_log = nullptr;
+
+	Registry& registry()
+	{
+		static Registry* instance = new Registry();
+		return *instance;
+	}
+
+	// microseconds with three decimals, as the format wants them
+	void writeMicroseconds(std::ofstream& file, std::int64_t nanoseconds)
+	{
+		char fraction[4]{ static_cast<char>('0' + nanoseconds / 100 % 10),
+			static_cast<char>('0' + nanoseconds / 10 % 10), static_cast<char>('0' + nanoseconds % 10), '\0' };
+		file << nanoseconds / 1000 << '.' << fraction;
+	}
+
+	void writeProfile()
+	{
+		Registry& registry_ref = registry();
+		std::lock_guard<std::mutex> lock(registry_ref.mutex);
+		std::ofstream file(PROFILE_FILE);
+		if (not file)
+			return;
+		std::uint64_t dropped = 0;
+		file << "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Tower Defence\"}}";
+		for (const ThreadLog* log : registry_ref.logs)
+		{
+			const char* name = log->name.load(std::memory_order_acquire);
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->id
+				<< ",\"args\":{\"name\":\"" << (name != nullptr ? name : "thread") << ' ' << log->id << "\"}}";
+			std::size_t count = log->count.load(std::memory_order_acquire);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const Zone& zone = log->chunks[i / PROFILE_CHUNK].load(std::memory_order_relaxed)[i % PROFILE_CHUNK];
+				file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->id << ",\"ts\":";
+				writeMicroseconds(file, zone.begin);
+				file << ",\"dur\":";
+				writeMicroseconds(file, zone.end - zone.begin);
+				file << '}';
+			}
+			dropped += log->dropped.load(std::memory_order_relaxed);
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped zones\":" << dropped << "}}\n";
+	}
+
+	ThreadLog& threadLog()
+	{
+		if (t_log != nullptr)
+			return *t_log;
+		Registry& registry_ref = registry();
+		std::lock_guard<std::mutex> lock(registry_ref.mutex);
+		if (registry_ref.logs.empty())
+			std::atexit(writeProfile);
+		t_log = new ThreadLog();
+		t_log->id = static_cast<int>(registry_ref.logs.size()) + 1;
+		registry_ref.logs.push_back(t_log);
+		return *t_log;
+	}
+}
+
+std::int64_t profileClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s_start).count();
+}
+
+void recordZone(const char* name, std::int64_t begin, std::int64_t end)
+{
+	ThreadLog& log = threadLog();
+	std::size_t count = log.count.load(std::memory_order_relaxed);
+	std::size_t chunk = count / PROFILE_CHUNK;
+	if (chunk >= PROFILE_CHUNKS)
+	{
+		log.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	Zone* zones = log.chunks[chunk].load(std::memory_order_relaxed);
+	if (zones == nullptr)
+	{
+		zones = new Zone[PROFILE_CHUNK];
+		log.chunks[chunk].store(zones, std::memory_order_relaxed);
+	}
+	zones[count % PROFILE_CHUNK] = Zone{ name, begin, end };
+	log.count.store(count + 1, std::memory_order_release);
+}
+
+void nameThread(const char* name)
+{
+	threadLog().name.store(name, std::memory_order_release);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+
+// Zone profiler. PROFILE_ZONE("name") times the rest of the enclosing scope and
+// PROFILE_THREAD("name") names the calling thread. Every thread keeps its zones in
+// buffers of its own, so recording one takes no lock: two clock reads and a store.
+// At exit all zones are written to PROFILE_FILE in the Chrome trace format, for
+// chrome://tracing or Perfetto. A zone costs a few tens of nanoseconds, so those in
+// Entity::move, timed for every entity on every tick, weigh on crowded levels.
+// The macros are empty unless PROFILING is defined, as the Profile|x64 configuration
+// of the project does; otherwise nothing of this is built.
+
+#if defined(PROFILING)
+
+const char* const PROFILE_FILE = "profile.json";
+const int PROFILE_CHUNK = 4096; // zones, allocated together
+const int PROFILE_CHUNKS = 1024; // per thread; zones beyond them are only counted
+
+std::int64_t profileClock(); // nanoseconds since the start
+void recordZone(const char* name, std::int64_t begin, std::int64_t end);
+void nameThread(const char* name);
+
+class ProfileZone
+{
+private:
+
+	const char* m_name;
+	std::int64_t m_begin;
+
+public:
+
+	ProfileZone(const char* name) : m_name(name), m_begin(profileClock()) {}
+	~ProfileZone() { recordZone(m_name, m_begin, profileClock()); }
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_JOIN(left, right) left##right
+#define PROFILE_VARIABLE(line) PROFILE_JOIN(profile_zone_, line)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_VARIABLE(__LINE__)(name)
+#define PROFILE_THREAD(name) nameThread(name)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+#endif
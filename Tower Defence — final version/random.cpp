@@ -0,0 +1,40 @@
+#include "random.h"
+
+Random::Random(std::uint64_t seed)
+{
+	this->seed(seed);
+}
+
+void Random::seed(std::uint64_t seed)
+{
+	// one splitmix64 step spreads nearby seeds apart and never leaves the state zero
+	std::uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+	m_state = z != 0 ? z : 1;
+}
+
+std::uint32_t Random::next()
+{
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+	return static_cast<std::uint32_t>((m_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+int Random::below(int bound)
+{
+	// multiply-shift instead of modulo: no division and no bias towards low values
+	return static_cast<int>((static_cast<std::uint64_t>(next()) * static_cast<std::uint32_t>(bound)) >> 32);
+}
+
+std::uint64_t Random::getState() const
+{
+	return m_state;
+}
+
+void Random::setState(std::uint64_t state)
+{
+	m_state = state != 0 ? state : 1;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+// Small seeded generator (xorshift64*) owned by each simulation. Unlike std::rand it
+// is not shared between threads, costs one word to copy, and the same seed always
+// gives the same game, which forecasts, replays and batch tools rely on.
+
+class Random
+{
+private:
+
+	std::uint64_t m_state;
+
+public:
+
+	Random(std::uint64_t seed = 1);
+
+	void seed(std::uint64_t seed);
+	std::uint32_t next();
+	int below(int bound);
+
+	std::uint64_t getState() const;
+	void setState(std::uint64_t state);
+};
@@ -0,0 +1,133 @@
+#include "range.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RANGE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	unsigned int scalarKernel(const RangeUnit* xs, const RangeUnit* ys,
+		RangeUnit x, RangeUnit y, std::int32_t squared_radius)
+	{
+		unsigned int mask = 0U;
+		for (int i = 0; i < RANGE_BLOCK; ++i)
+		{
+			std::int32_t dx = xs[i] - x, dy = ys[i] - y;
+			if (dx * dx + dy * dy < squared_radius)
+				mask |= 1U << i;
+		}
+		return mask;
+	}
+
+#ifdef RANGE_X86
+	unsigned int sse2Kernel(const RangeUnit* xs, const RangeUnit* ys,
+		RangeUnit x, RangeUnit y, std::int32_t squared_radius)
+	{
+		const __m128i cx = _mm_set1_epi16(x), cy = _mm_set1_epi16(y), r2 = _mm_set1_epi32(squared_radius);
+		unsigned int mask = 0U;
+		for (int i = 0; i < RANGE_BLOCK; i += 8)
+		{
+			__m128i dx = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i)), cx);
+			__m128i dy = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i)), cy);
+			// interleaved (dx, dy) pairs: one madd yields dx * dx + dy * dy per entity
+			__m128i low = _mm_unpacklo_epi16(dx, dy), high = _mm_unpackhi_epi16(dx, dy);
+			__m128i d2_low = _mm_madd_epi16(low, low), d2_high = _mm_madd_epi16(high, high);
+			unsigned int bits_low = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(d2_low, r2)));
+			unsigned int bits_high = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(d2_high, r2)));
+			mask |= (bits_low | bits_high << 4) << i;
+		}
+		return mask;
+	}
+
+	TARGET_AVX2 unsigned int avx2Kernel(const RangeUnit* xs, const RangeUnit* ys,
+		RangeUnit x, RangeUnit y, std::int32_t squared_radius)
+	{
+		const __m256i cx = _mm256_set1_epi16(x), cy = _mm256_set1_epi16(y), r2 = _mm256_set1_epi32(squared_radius);
+		__m256i dx = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs)), cx);
+		__m256i dy = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys)), cy);
+		// unpacking works per 128-bit lane: low holds entities 0-3 and 8-11, high 4-7 and 12-15
+		__m256i low = _mm256_unpacklo_epi16(dx, dy), high = _mm256_unpackhi_epi16(dx, dy);
+		__m256i d2_low = _mm256_madd_epi16(low, low), d2_high = _mm256_madd_epi16(high, high);
+		unsigned int bits_low = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(r2, d2_low)));
+		unsigned int bits_high = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(r2, d2_high)));
+		return (bits_low & 0x0fU) | (bits_high & 0x0fU) << 4 | (bits_low & 0xf0U) << 4 | (bits_high & 0xf0U) << 8;
+	}
+
+	bool supportsAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+		if (not osxsave or not avx or (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	struct Dispatch
+	{
+		RangeKernel kernel = scalarKernel;
+		const char* name = "scalar";
+
+		Dispatch()
+		{
+#ifdef RANGE_X86
+			if (supportsAvx2())
+			{
+				kernel = avx2Kernel;
+				name = "AVX2";
+			}
+			else
+			{
+				kernel = sse2Kernel;
+				name = "SSE2";
+			}
+#endif
+		}
+	};
+
+	const Dispatch s_dispatch;
+}
+
+RangeUnit toRangeUnits(Fixed value)
+{
+	const Fixed limit = INT16_MAX;
+	Fixed units = value >> RANGE_SHIFT;
+	return static_cast<RangeUnit>(units < 0 ? 0 : units > limit ? limit : units);
+}
+
+std::int32_t squaredRange(Fixed radius)
+{
+	std::int32_t units = toRangeUnits(radius);
+	return units * units;
+}
+
+unsigned int rangeMask(const RangeUnit* xs, const RangeUnit* ys, int count,
+	RangeUnit x, RangeUnit y, std::int32_t squared_radius)
+{
+	unsigned int mask = s_dispatch.kernel(xs, ys, x, y, squared_radius);
+	if (count < RANGE_BLOCK)
+		mask &= (1U << count) - 1U;
+	return mask;
+}
+
+const char* rangeKernelName()
+{
+	return s_dispatch.name;
+}
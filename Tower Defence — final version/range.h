@@ -0,0 +1,26 @@
+#pragma once
+#include "fixed.h"
+#include <cstdint>
+
+// Squared-distance range test run on blocks of entity positions.
+// The variant (AVX2, SSE2 or scalar) is selected once at startup.
+
+const int RANGE_BLOCK = 16;
+
+// The test works on 16-bit coordinates in 1/16 of a pixel, which covers 2047 pixels
+// and keeps dx * dx + dy * dy within 32 bits, so every variant gives the exact same mask.
+const int RANGE_SHIFT = FIXED_SHIFT - 4;
+
+using RangeUnit = std::int16_t;
+
+// Bit i of the result is set when (xs[i], ys[i]) lies strictly inside the circle
+// of the given squared radius around (x, y). Both arrays hold RANGE_BLOCK values.
+using RangeKernel = unsigned int (*)(const RangeUnit* xs, const RangeUnit* ys,
+	RangeUnit x, RangeUnit y, std::int32_t squared_radius);
+
+RangeUnit toRangeUnits(Fixed value);
+std::int32_t squaredRange(Fixed radius);
+
+unsigned int rangeMask(const RangeUnit* xs, const RangeUnit* ys, int count,
+	RangeUnit x, RangeUnit y, std::int32_t squared_radius);
+const char* rangeKernelName();
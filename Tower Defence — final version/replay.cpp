@@ -0,0 +1,314 @@
+#include "replay.h"
+#include "arguments.h"
+#include "binary.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	// runs the recorded commands up to the given tick, checking the waves that end on the way
+	void advance(Simulation& simulation, const Replay& replay, int& next, std::uint64_t until, Playback& playback)
+	{
+		bool fighting = simulation.isFighting();
+		while (not simulation.isOver() and simulation.getTick() < until)
+		{
+			for (; next < replay.commands.size() and replay.commands[next].tick == simulation.getTick(); ++next)
+				simulation.execute(replay.commands[next].command);
+			simulation.tick();
+			if (fighting and not simulation.isFighting() and playback.waves_checked < replay.checksums.size())
+			{
+				if (simulation.checksum() != replay.checksums[playback.waves_checked]
+					and playback.first_divergent_wave < 0)
+					playback.first_divergent_wave = playback.waves_checked;
+				++playback.waves_checked;
+			}
+			fighting = simulation.isFighting();
+		}
+		playback.ticks = simulation.getTick();
+		playback.result = simulation.getResult();
+		playback.health = simulation.getHealth();
+	}
+}
+
+Recorder::Recorder(const std::string& map_name, const std::string& level_name, std::uint64_t seed, int money)
+{
+	m_replay.map_name = map_name;
+	m_replay.level_name = level_name;
+	m_replay.seed = seed;
+	m_replay.money = money;
+	hashData(m_replay);
+}
+
+void Recorder::record(const Simulation& simulation, const Command& command)
+{
+	m_replay.commands.push_back({ simulation.getTick(), command });
+}
+
+void Recorder::keep(const Simulation& simulation)
+{
+	Keyframe& keyframe = m_replay.keyframes.emplace_back();
+	keyframe.tick = simulation.getTick();
+	keyframe.commands = static_cast<int>(m_replay.commands.size());
+	keyframe.waves = static_cast<int>(m_replay.checksums.size());
+	ByteWriter writer;
+	simulation.write(writer);
+	keyframe.state = writer.getBytes();
+	m_last_keyframe = keyframe.tick;
+}
+
+void Recorder::observe(const Simulation& simulation)
+{
+	if (m_fighting and not simulation.isFighting())
+	{
+		m_replay.checksums.push_back(simulation.checksum());
+		keep(simulation);
+	}
+	else if (simulation.getTick() - m_last_keyframe >= REPLAY_KEYFRAME_PERIOD)
+		keep(simulation);
+	m_fighting = simulation.isFighting();
+}
+
+const Replay& Recorder::finish(const Simulation& simulation)
+{
+	m_replay.ticks = simulation.getTick();
+	m_replay.result = simulation.getResult();
+	return m_replay;
+}
+
+void hashData(Replay& replay)
+{
+	Manager& manager_ref = Manager::getInstance();
+	replay.map_hash = hashFile(manager_ref.getMapPath(replay.map_name));
+	replay.level_hash = hashFile(manager_ref.getLevelPath(replay.level_name));
+	replay.entities_hash = hashFile(std::filesystem::path(ENTITIES_DIR) / ENTITIES_SOURCE);
+	replay.defences_hash = hashFile(std::filesystem::path(DEFENCES_DIR) / DEFENCES_SOURCE);
+}
+
+void saveReplay(const std::filesystem::path& path, const Replay& replay)
+{
+	ByteWriter writer;
+	writer.writeWord(REPLAY_MAGIC);
+	writer.writeVarint(REPLAY_VERSION);
+	writer.writeWord(replay.seed);
+	writer.writeSigned(replay.money);
+	writer.writeString(replay.map_name);
+	writer.writeString(replay.level_name);
+	writer.writeWord(replay.map_hash);
+	writer.writeWord(replay.level_hash);
+	writer.writeWord(replay.entities_hash);
+	writer.writeWord(replay.defences_hash);
+	writer.writeVarint(replay.ticks);
+	writer.writeByte(static_cast<std::uint8_t>(replay.result));
+
+	// ticks as differences from the previous command, positions in whole pixels
+	writer.writeVarint(replay.commands.size());
+	std::uint64_t tick = 0;
+	for (const ReplayCommand& entry : replay.commands)
+	{
+		writer.writeVarint(entry.tick - tick);
+		tick = entry.tick;
+		const Command& command = entry.command;
+		if (command.kind == Command::Kind::Start)
+			writer.writeByte(0);
+		else
+		{
+			writer.writeByte(static_cast<std::uint8_t>(static_cast<int>(command.defence) + 2));
+			writer.writeSigned(command.position.x);
+			writer.writeSigned(command.position.y);
+		}
+	}
+	writer.writeVarint(replay.checksums.size());
+	for (std::uint64_t checksum : replay.checksums)
+		writer.writeWord(checksum);
+
+	// keyframes, then their index, then where the index starts as the last 8 bytes
+	std::vector<std::uint64_t> offsets;
+	for (const Keyframe& keyframe : replay.keyframes)
+	{
+		offsets.push_back(writer.getSize());
+		writer.writeBytes(keyframe.state.data(), keyframe.state.size());
+	}
+	std::uint64_t index = writer.getSize();
+	writer.writeVarint(replay.keyframes.size());
+	for (int i = 0; i < replay.keyframes.size(); ++i)
+	{
+		const Keyframe& keyframe = replay.keyframes[i];
+		writer.writeVarint(keyframe.tick);
+		writer.writeVarint(keyframe.commands);
+		writer.writeVarint(keyframe.waves);
+		writer.writeVarint(offsets[i]);
+		writer.writeVarint(keyframe.state.size());
+	}
+	writer.writeWord(index);
+	writeFile(path, writer.getBytes());
+}
+
+void loadReplay(const std::filesystem::path& path, Replay& replay)
+{
+	std::vector<std::uint8_t> bytes;
+	readFile(path, bytes);
+	ByteReader reader(bytes);
+	if (reader.readWord() != REPLAY_MAGIC)
+		throw Error(Problem::FileError);
+	std::uint64_t version = reader.readVarint();
+	if (version < 1 or version > REPLAY_VERSION)
+		throw Error(Problem::FileError);
+	replay.seed = reader.readWord();
+	replay.money = static_cast<int>(reader.readSigned());
+	replay.map_name = reader.readString();
+	replay.level_name = reader.readString();
+	replay.map_hash = reader.readWord();
+	replay.level_hash = reader.readWord();
+	replay.entities_hash = reader.readWord();
+	replay.defences_hash = reader.readWord();
+	replay.ticks = reader.readVarint();
+	replay.result = static_cast<Result>(reader.readByte());
+
+	replay.commands.resize(reader.readCount());
+	std::uint64_t tick = 0;
+	for (ReplayCommand& entry : replay.commands)
+	{
+		tick += reader.readVarint();
+		entry.tick = tick;
+		int kind = reader.readByte();
+		if (kind == 0)
+			entry.command.kind = Command::Kind::Start;
+		else
+		{
+			entry.command.kind = Command::Kind::Place;
+			entry.command.defence = static_cast<DefenceType>(kind - 2);
+			entry.command.position.x = static_cast<int>(reader.readSigned());
+			entry.command.position.y = static_cast<int>(reader.readSigned());
+		}
+	}
+	replay.checksums.resize(reader.readCount());
+	for (std::uint64_t& checksum : replay.checksums)
+		checksum = reader.readWord();
+
+	replay.keyframes.clear();
+	if (version < 2)
+		return;
+	reader.seek(bytes.size() - std::min<std::size_t>(bytes.size(), 8));
+	reader.seek(reader.readWord());
+	replay.keyframes.resize(reader.readCount());
+	for (Keyframe& keyframe : replay.keyframes)
+	{
+		keyframe.tick = reader.readVarint();
+		keyframe.commands = static_cast<int>(reader.readVarint());
+		keyframe.waves = static_cast<int>(reader.readVarint());
+		std::size_t offset = reader.readVarint(), size = reader.readVarint();
+		if (keyframe.commands > replay.commands.size() or keyframe.waves > replay.checksums.size()
+			or offset > bytes.size() or size > bytes.size() - offset)
+			throw Error(Problem::FileError);
+		keyframe.state.assign(bytes.begin() + offset, bytes.begin() + offset + size);
+	}
+}
+
+Playback playReplay(const Level& level, const Replay& replay)
+{
+	Simulation simulation(level, nullptr, replay.seed);
+	simulation.setMoney(replay.money);
+	Playback playback;
+	int next = 0;
+	advance(simulation, replay, next, replay.ticks, playback);
+	return playback;
+}
+
+std::unique_ptr<Simulation> seekReplay(const Level& level, const Replay& replay, std::uint64_t tick)
+{
+	auto simulation = std::make_unique<Simulation>(level, nullptr, replay.seed);
+	simulation->setMoney(replay.money);
+	Playback playback;
+	int next = 0;
+	auto keyframe = std::upper_bound(replay.keyframes.begin(), replay.keyframes.end(), tick,
+		[](std::uint64_t tick, const Keyframe& keyframe) { return tick < keyframe.tick; });
+	if (keyframe != replay.keyframes.begin())
+	{
+		--keyframe;
+		ByteReader reader(keyframe->state);
+		simulation->read(reader);
+		next = keyframe->commands;
+		playback.waves_checked = keyframe->waves;
+	}
+	advance(*simulation, replay, next, std::min(tick, replay.ticks), playback);
+	return simulation;
+}
+
+int runReplay(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: replay <replay file> [<tick to seek>]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		Replay replay;
+		loadReplay(argv[2], replay);
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		manager_ref.loadMap(replay.map_name);
+		Level level;
+		manager_ref.loadLevel(replay.level_name, level);
+
+		Replay current = replay;
+		hashData(current);
+		if (current.map_hash != replay.map_hash)
+			std::cout << "The map file differs from the recorded one." << std::endl;
+		if (current.level_hash != replay.level_hash)
+			std::cout << "The level file differs from the recorded one." << std::endl;
+		if (current.entities_hash != replay.entities_hash)
+			std::cout << "The entities file differs from the recorded one." << std::endl;
+		if (current.defences_hash != replay.defences_hash)
+			std::cout << "The defences file differs from the recorded one." << std::endl;
+
+		if (argc > 3)
+		{
+			// seeking, compared with simulating from the start
+			std::uint64_t tick = parseUnsigned(argv[3]);
+			auto start = std::chrono::steady_clock::now();
+			std::unique_ptr<Simulation> sought = seekReplay(level, replay, tick);
+			std::chrono::duration<double> seek_time = std::chrono::steady_clock::now() - start;
+			Replay bare = replay;
+			bare.keyframes.clear();
+			start = std::chrono::steady_clock::now();
+			std::unique_ptr<Simulation> played = seekReplay(level, bare, tick);
+			std::chrono::duration<double> play_time = std::chrono::steady_clock::now() - start;
+			std::cout << "Tick " << sought->getTick() << ": health " << sought->getHealth() << ", money "
+				<< sought->getMoney() << ", " << sought->getEntities().size() << " entities, "
+				<< sought->getDefences().size() << " defences" << std::endl
+				<< "Sought in " << seek_time.count() * 1e3 << " ms from " << replay.keyframes.size()
+				<< " keyframes, played from the start in " << play_time.count() * 1e3 << " ms, states "
+				<< (sought->checksum() == played->checksum() ? "equal" : "different") << std::endl;
+			return 0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		Playback playback = playReplay(level, replay);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << replay.map_name << ", " << replay.level_name << ": " << replay.commands.size()
+			<< " commands, " << playback.ticks << " of " << replay.ticks << " ticks played in "
+			<< elapsed.count() << " s, " << playback.ticks / std::max(elapsed.count(), 1e-9) / FREQUENCY
+			<< " times real time" << std::endl;
+		if (playback.first_divergent_wave >= 0)
+			std::cout << "Diverged from the recording at wave " << playback.first_divergent_wave + 1 << "." << std::endl;
+		else if (playback.waves_checked < replay.checksums.size() or playback.result != replay.result)
+			std::cout << "Ended differently from the recording." << std::endl;
+		else
+			std::cout << "Matches the recording: " << playback.waves_checked << " waves checked, health "
+				<< playback.health << " left." << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
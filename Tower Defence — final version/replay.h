@@ -0,0 +1,90 @@
+#pragma once
+#include "manager.h"
+#include "simulation.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Replays hold the seed, the names of the map and level with hashes of the data files,
+// and the player's commands with the ticks they were carried out at. Everything else,
+// path choices included, comes again from the seeded simulation, so a whole game takes
+// a few hundred bytes. A checksum of the state after every wave tells whether a playback
+// still follows the recorded game. Keyframes of the whole state, taken when waves end and
+// every REPLAY_KEYFRAME_PERIOD ticks, are indexed at the end of the file, so seeking to
+// a tick only simulates the ticks after the nearest keyframe.
+// Usage: replay <replay file> [<tick to seek>]
+
+const std::uint32_t REPLAY_MAGIC = 0x50524454; // "TDRP"
+const int REPLAY_VERSION = 2; // 1 had no keyframes
+const std::uint64_t REPLAY_KEYFRAME_PERIOD = 3600;
+
+struct ReplayCommand
+{
+	std::uint64_t tick = 0; // executed before this tick of the simulation ran
+	Command command;
+};
+
+struct Keyframe
+{
+	std::uint64_t tick = 0; // taken after this tick
+	int commands = 0; // executed before it
+	int waves = 0; // checksums before it
+	std::vector<std::uint8_t> state; // written by Simulation::write
+};
+
+struct Replay
+{
+	std::uint64_t seed = 1;
+	int money = INITIAL_MONEY;
+	std::string map_name;
+	std::string level_name;
+	std::uint64_t map_hash = 0;
+	std::uint64_t level_hash = 0;
+	std::uint64_t entities_hash = 0;
+	std::uint64_t defences_hash = 0;
+	std::vector<ReplayCommand> commands;
+	std::vector<std::uint64_t> checksums; // after each wave
+	std::vector<Keyframe> keyframes; // in order of ticks
+	std::uint64_t ticks = 0; // when the recording stopped
+	Result result = Result::Interrupt;
+};
+
+// Builds a replay while the game is played: commands as they are executed, checksums
+// and keyframes whenever a wave ends. Used from the simulation thread only.
+class Recorder
+{
+private:
+
+	Replay m_replay;
+	bool m_fighting = false;
+	std::uint64_t m_last_keyframe = 0;
+
+	void keep(const Simulation& simulation);
+
+public:
+
+	Recorder(const std::string& map_name, const std::string& level_name, std::uint64_t seed, int money);
+
+	void record(const Simulation& simulation, const Command& command);
+	void observe(const Simulation& simulation); // after every tick
+	const Replay& finish(const Simulation& simulation);
+};
+
+struct Playback
+{
+	std::uint64_t ticks = 0;
+	int waves_checked = 0;
+	int first_divergent_wave = -1;
+	Result result = Result::Interrupt;
+	int health = 0;
+};
+
+void hashData(Replay& replay); // of the data files the names point to now
+void saveReplay(const std::filesystem::path& path, const Replay& replay);
+void loadReplay(const std::filesystem::path& path, Replay& replay);
+Playback playReplay(const Level& level, const Replay& replay); // on the loaded map
+std::unique_ptr<Simulation> seekReplay(const Level& level, const Replay& replay, std::uint64_t tick);
+
+int runReplay(int argc, char* argv[]);
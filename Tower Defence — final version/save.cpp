@@ -0,0 +1,93 @@
+#include "save.h"
+#include "binary.h"
+#include "error.h"
+
+std::filesystem::path savePath(const std::string& name)
+{
+	return std::filesystem::path(SAVES_DIR) / (name + SAVE_EXTENSION);
+}
+
+void captureGame(const Simulation& simulation, SavedGame& game)
+{
+	ByteWriter writer;
+	simulation.write(writer);
+	game.state = writer.getBytes();
+}
+
+void restoreGame(const SavedGame& game, Simulation& simulation)
+{
+	ByteReader reader(game.state);
+	simulation.read(reader);
+	if (not reader.atEnd())
+		throw Error(Problem::FileError);
+}
+
+void saveGame(const std::filesystem::path& path, const SavedGame& game)
+{
+	ByteWriter writer;
+	writer.writeWord(SAVE_MAGIC);
+	writer.writeVarint(SAVE_VERSION);
+	writer.writeString(game.map_name);
+	writer.writeString(game.level_name);
+	writer.writeVarint(game.state.size());
+	writer.writeBytes(game.state.data(), game.state.size());
+	writer.writeWord(hashBytes(game.state.data(), game.state.size()));
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path());
+	writeFile(path, writer.getBytes());
+}
+
+void loadGame(const std::filesystem::path& path, SavedGame& game)
+{
+	std::vector<std::uint8_t> bytes;
+	readFile(path, bytes);
+	ByteReader reader(bytes);
+	if (reader.readWord() != SAVE_MAGIC or reader.readVarint() != SAVE_VERSION)
+		throw Error(Problem::FileError);
+	game.map_name = reader.readString();
+	game.level_name = reader.readString();
+	std::size_t size = reader.readCount();
+	const std::uint8_t* state = reader.readBytes(size);
+	if (reader.readWord() != hashBytes(state, size))
+		throw Error(Problem::FileError);
+	game.state.assign(state, state + size);
+}
+
+void Autosaver::work(std::stop_token stop)
+{
+	while (true)
+	{
+		std::map<std::filesystem::path, SavedGame> games;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (not m_wake.wait(lock, stop, [this]() { return not m_pending.empty(); }))
+				return;
+			games.swap(m_pending);
+		}
+		for (const auto& [path, game] : games)
+		{
+			// a failed save is not fatal to the game; the next one tries again
+			try
+			{
+				saveGame(path, game);
+			}
+			catch (...)
+			{
+			}
+		}
+	}
+}
+
+Autosaver::Autosaver() :
+	m_thread([this](std::stop_token stop) { work(stop); })
+{
+}
+
+void Autosaver::save(const std::filesystem::path& path, SavedGame game)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending[path] = std::move(game);
+	}
+	m_wake.notify_one();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "simulation.h"
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Saved games: the names of the map and level and the whole state of the simulation in
+// a versioned binary file. Capturing the state takes microseconds on the simulation
+// thread; the Autosaver writes the file on its own thread, so no frame waits for a disk.
+
+const std::uint32_t SAVE_MAGIC = 0x56534454; // "TDSV"
+const int SAVE_VERSION = 1;
+const std::string SAVES_DIR = "Saves", SAVE_EXTENSION = ".tds";
+const std::string AUTOSAVE_NAME = "autosave", QUICKSAVE_NAME = "quicksave";
+
+struct SavedGame
+{
+	std::string map_name;
+	std::string level_name;
+	std::vector<std::uint8_t> state; // written by Simulation::write
+};
+
+std::filesystem::path savePath(const std::string& name);
+void captureGame(const Simulation& simulation, SavedGame& game); // the state; the names are left as they are
+void restoreGame(const SavedGame& game, Simulation& simulation);
+void saveGame(const std::filesystem::path& path, const SavedGame& game);
+void loadGame(const std::filesystem::path& path, SavedGame& game);
+
+// Writes saved games on its own thread. A newer game handed over for the same file
+// before the older one was written replaces it; pending games are written before exit.
+class Autosaver
+{
+private:
+
+	std::mutex m_mutex;
+	std::condition_variable_any m_wake;
+	std::map<std::filesystem::path, SavedGame> m_pending;
+	std::jthread m_thread; // last, so that it stops before the rest is destroyed
+
+	void work(std::stop_token stop);
+
+public:
+
+	Autosaver();
+	Autosaver(const Autosaver&) = delete;
+	Autosaver& operator=(const Autosaver&) = delete;
+
+	void save(const std::filesystem::path& path, SavedGame game);
+};
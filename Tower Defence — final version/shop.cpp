@@ -42,11 +42,13 @@ void Shop::setSize(float width, float height)
 	m_background.setSize(sf::Vector2f(width, height));
 }
 
-void Shop::drawYourself(sf::RenderWindow& window)
+int Shop::drawYourself(sf::RenderWindow& window)
 {
+	int draws = 1;
 	window.draw(m_background);
 	for (auto it = m_buttons.begin(); it != m_buttons.end(); ++it)
-		it->second.drawYourself(window);
+		draws += it->second.drawYourself(window);
+	return draws;
 }
 
 DefenceType Shop::select(const sf::Vector2f& coords)
@@ -67,7 +69,7 @@ void Shop::toggleButton()
 	m_buttons[m_currently_selected].toggle();
 }
 
-void Shop::assignDefence(DefenceType type, std::unique_ptr<Defence>& pointer)
+void Shop::assignDefence(DefenceType type, Defence*& pointer)
 {
 	Manager& manager_ref = Manager::getInstance();
 	const DefenceRecord& record = manager_ref.getDefenceRecord(type);
@@ -76,24 +78,48 @@ void Shop::assignDefence(DefenceType type, std::unique_ptr<Defence>& pointer)
 	case DefenceType::UniShooter:
 	case DefenceType::MultiShooter:
 	case DefenceType::Cannon:
-		pointer = std::make_unique<Shooter>();
+		pointer = m_shooters.make();
 		break;
 	case DefenceType::Freezer:
-		pointer = std::make_unique<Freezer>();
+		pointer = m_freezers.make();
 		break;
 	default:
 		pointer = nullptr;
 	}
 	if (pointer != nullptr)
 	{
+		pointer->setType(type);
 		pointer->setForce(record.force);
 		pointer->setHitsPerOnce(record.hits);
 		pointer->setPeriod(record.period);
 		pointer->setRadius(record.radius);
 		pointer->setCost(record.cost);
-		pointer->setTexture(record.texture);
-		sf::Vector2f offset = -.5f * record.scale * record.dimensions;
-		pointer->setScale(record.scale);
-		pointer->setShift(offset);
 	}
 }
+
+void Shop::copyDefence(const Defence* original, Defence*& pointer)
+{
+	switch (original->getType())
+	{
+	case DefenceType::UniShooter:
+	case DefenceType::MultiShooter:
+	case DefenceType::Cannon:
+		pointer = m_shooters.make(*static_cast<const Shooter*>(original));
+		break;
+	case DefenceType::Freezer:
+		pointer = m_freezers.make(*static_cast<const Freezer*>(original));
+		break;
+	default:
+		pointer = nullptr;
+	}
+}
+
+void Shop::recycleDefence(Defence* pointer)
+{
+	if (pointer == nullptr)
+		return;
+	if (pointer->getType() == DefenceType::Freezer)
+		m_freezers.recycle(static_cast<Freezer*>(pointer));
+	else
+		m_shooters.recycle(static_cast<Shooter*>(pointer));
+}
\ No newline at end of file
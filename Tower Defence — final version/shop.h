@@ -1,6 +1,7 @@
 #pragma once
 #include "button.h"
 #include "defence.h"
+#include "pool.h"
 #include <map>
 #include <unordered_map>
 #include <SFML/Audio.hpp>
@@ -28,6 +29,8 @@ private:
 	sf::RectangleShape m_background;
 	std::map<DefenceType, Button> m_buttons;
 	DefenceType m_currently_selected;
+	Pool<Shooter> m_shooters;
+	Pool<Freezer> m_freezers;
 
 	Shop();
 
@@ -44,10 +47,12 @@ public:
 	void setPosition(float x, float y);
 	void setSize(float width, float height);
 
-	void drawYourself(sf::RenderWindow& window);
+	int drawYourself(sf::RenderWindow& window); // returns the number of draw calls
 
 	DefenceType select(const sf::Vector2f& coords);
 	void toggleButton();
 
-	void assignDefence(DefenceType type, std::unique_ptr<Defence>& pointer);
+	void assignDefence(DefenceType type, Defence*& pointer);
+	void copyDefence(const Defence* original, Defence*& pointer);
+	void recycleDefence(Defence* pointer);
 };
@@ -0,0 +1,584 @@
+#include "simulation.h"
+#include "binary.h"
+#include "error.h"
+#include "profile.h"
+#include "shop.h"
+#include "world.h"
+
+void Simulation::startWave()
+{
+	if (m_fighting or m_over)
+		return;
+	m_spawning = true;
+	m_fighting = true;
+}
+
+void Simulation::placeDefence(DefenceType type, const sf::Vector2i& position)
+{
+	if (type == DefenceType::None or m_over)
+		return;
+	const DefenceRecord& record = Manager::getInstance().getDefenceRecord(type);
+	if (m_money < record.cost)
+		return;
+	Defence* defence = nullptr;
+	Shop::getInstance().assignDefence(type, defence);
+	if (defence == nullptr)
+		return;
+	m_money -= defence->getCost();
+	defence->setPosition(static_cast<sf::Vector2f>(position));
+	defence->stagger(m_random);
+	m_defences.push_back(defence);
+	m_dividers.emplace_back(m_entities.end());
+}
+
+void Simulation::spawnEntity()
+{
+	PROFILE_ZONE("Simulation::spawnEntity");
+	if (m_level.empty())
+		return;
+	int entityIndex = m_level.front().front().index;
+	if (--m_level.front().front().count == 0)
+	{
+		m_level.front().pop();
+		if (m_level.front().empty())
+		{
+			m_level.pop();
+			m_spawning = false;
+		}
+	}
+	if (m_defences.empty())
+	{
+		revive(m_entities.end(), entityIndex);
+		m_dividers.front() = m_entities.begin();
+	}
+	else
+	{
+		revive(m_dividers[m_inserter], entityIndex);
+		for (int i = m_inserter - 1; i >= 0; --i)
+		{
+			if (m_dividers[i] == m_dividers[m_inserter])
+				--m_dividers[i];
+		}
+		if (++m_inserter == m_dividers.size())
+			m_inserter = 1;
+	}
+}
+
+void Simulation::doAttacking()
+{
+	PROFILE_ZONE("Simulation::doAttacking");
+	for (int i = 0; i < m_defences.size(); ++i)
+		m_defences[i]->tick();
+
+	struct Strike
+	{
+		Defence* defence;
+		int segment;
+	};
+	struct Round
+	{
+		Strike* strikes;
+		std::list<Entity>::iterator* dividers;
+	};
+
+	auto make_attack = [](void* context, int task)
+	{
+		Round& round = *static_cast<Round*>(context);
+		Strike& strike = round.strikes[task];
+		strike.defence->attack(round.dividers[strike.segment], round.dividers[strike.segment + 1]);
+	};
+
+	Round round;
+	round.strikes = m_scratch.make<Strike>(m_defences.size());
+	round.dividers = m_dividers.data();
+	for (int i = 0; i < m_defences.size(); ++i)
+	{
+		int count = 0;
+		for (int j = 0; j < m_defences.size(); ++j)
+		{
+			if (m_defences[j]->ready())
+			{
+				round.strikes[count].defence = m_defences[j];
+				round.strikes[count].segment = (j + i) % m_defences.size();
+				++count;
+			}
+		}
+		if (count == 0)
+			break;
+		if (m_workers != nullptr)
+			m_workers->run(count, make_attack, &round);
+		else
+		{
+			for (int task = 0; task < count; ++task)
+				make_attack(&round, task);
+		}
+	}
+
+	++m_stats.attack_rounds;
+	for (int i = 0; i < m_defences.size(); ++i)
+	{
+		m_stats.range_tests += m_defences[i]->getRangeTests();
+		m_stats.hits += m_defences[i]->getHitsDone();
+		m_defences[i]->reset();
+	}
+
+	Manager& manager_ref = Manager::getInstance();
+	auto it = m_entities.begin();
+	while (it != m_entities.end())
+	{
+		if (it->isAlive())
+			++it;
+		else
+		{
+			m_money += manager_ref.getEntityRecord(it->getType()).prize;
+			it = bury(it);
+		}
+	}
+}
+
+void Simulation::moveEntities()
+{
+	Manager& manager_ref = Manager::getInstance();
+	auto it = m_entities.begin();
+	while (it != m_entities.end())
+	{
+		if (it->move(m_random))
+			++it;
+		else
+		{
+			++m_leaks;
+			m_health -= manager_ref.getEntityRecord(it->getType()).force;
+			if (m_health <= 0 and not m_over)
+			{
+				m_result = Result::Failure;
+				m_over = true;
+			}
+			it = bury(it);
+		}
+	}
+}
+
+std::list<Entity>::iterator Simulation::revive(std::list<Entity>::iterator position, int type)
+{
+	if (m_graveyard.empty())
+		return m_entities.emplace(position, type, m_random);
+	auto it = m_graveyard.begin();
+	*it = Entity(type, m_random);
+	m_entities.splice(position, m_graveyard, it);
+	return it;
+}
+
+std::list<Entity>::iterator Simulation::bury(std::list<Entity>::iterator it)
+{
+	for (int i = 0; i < m_dividers.size(); ++i)
+	{
+		if (m_dividers[i] == it)
+			++m_dividers[i];
+	}
+	auto next = std::next(it);
+	m_graveyard.splice(m_graveyard.end(), m_entities, it);
+	return next;
+}
+
+Simulation::Simulation(const Level& level, Workers* workers, std::uint64_t seed) :
+	m_level(level),
+	m_random(seed),
+	m_workers(workers)
+{
+	m_dividers.push_back(m_entities.begin());
+}
+
+Simulation::Simulation(const Simulation& other) :
+	m_level(other.m_level),
+	m_spawning(other.m_spawning),
+	m_fighting(other.m_fighting),
+	m_spawn_counter(other.m_spawn_counter),
+	m_entities(other.m_entities),
+	m_health(other.m_health),
+	m_leaks(other.m_leaks),
+	m_inserter(other.m_inserter),
+	m_attack_counter(other.m_attack_counter),
+	m_money(other.m_money),
+	m_tick(other.m_tick),
+	m_over(other.m_over),
+	m_result(other.m_result),
+	m_random(other.m_random),
+	m_workers(other.m_workers)
+{
+	Shop& shop_ref = Shop::getInstance();
+	m_defences.reserve(other.m_defences.size());
+	for (const Defence* defence : other.m_defences)
+	{
+		Defence* copy = nullptr;
+		shop_ref.copyDefence(defence, copy);
+		m_defences.push_back(copy);
+	}
+	// dividers point into the other list, so they are carried over by position
+	m_dividers.reserve(other.m_dividers.size());
+	for (std::list<Entity>::const_iterator divider : other.m_dividers)
+	{
+		auto it = m_entities.begin();
+		std::advance(it, std::distance(other.m_entities.begin(), divider));
+		m_dividers.push_back(it);
+	}
+}
+
+Simulation::~Simulation()
+{
+	Shop& shop_ref = Shop::getInstance();
+	for (Defence* defence : m_defences)
+		shop_ref.recycleDefence(defence);
+}
+
+void Simulation::reseed(std::uint64_t seed)
+{
+	m_random.seed(seed);
+}
+
+void Simulation::setWorkers(Workers* workers)
+{
+	m_workers = workers;
+}
+
+void Simulation::setMoney(int money)
+{
+	m_money = money;
+}
+
+void Simulation::setTimed(bool timed)
+{
+	m_timed = timed;
+}
+
+void Simulation::execute(const Command& command)
+{
+	switch (command.kind)
+	{
+	case Command::Kind::Start:
+		startWave();
+		break;
+	case Command::Kind::Place:
+		placeDefence(command.defence, command.position);
+		break;
+	}
+}
+
+void Simulation::tick()
+{
+	PROFILE_ZONE("Simulation::tick");
+	if (m_over)
+		return;
+	using Clock = std::chrono::steady_clock;
+	auto lap = [this](Clock::time_point& start, std::int64_t& time)
+	{
+		if (not m_timed)
+			return;
+		Clock::time_point now = Clock::now();
+		time += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+		start = now;
+	};
+	Clock::time_point start = m_timed ? Clock::now() : Clock::time_point();
+	m_scratch.reset();
+	++m_tick;
+	++m_stats.ticks;
+	if (m_spawning)
+	{
+		if (--m_spawn_counter == 0)
+		{
+			spawnEntity();
+			m_spawn_counter = SPAWN_PERIOD;
+		}
+	}
+	lap(start, m_stats.spawn_time);
+	if (--m_attack_counter <= 0)
+	{
+		m_attack_counter = ATTACK_PERIOD;
+		if (not m_defences.empty() and not m_entities.empty())
+			doAttacking();
+	}
+	lap(start, m_stats.attack_time);
+	moveEntities();
+	lap(start, m_stats.move_time);
+	if (m_fighting and not m_spawning and m_entities.empty())
+	{
+		m_fighting = false;
+		m_spawn_counter = 1;
+		if (m_level.empty() and not m_over)
+		{
+			m_over = true;
+			m_result = Result::Victory;
+		}
+		for (int i = 0; i < m_dividers.size(); ++i)
+			m_dividers[i] = m_entities.begin();
+		m_inserter = 1;
+	}
+}
+
+void Simulation::capture(Snapshot& snapshot) const
+{
+	snapshot.tick = m_tick;
+	snapshot.entities.clear();
+	for (const Entity& entity : m_entities)
+	{
+		EntityView& view = snapshot.entities.emplace_back();
+		view.previous = entity.getPreviousPosition();
+		view.position = entity.getPosition();
+		view.type = entity.getType();
+	}
+	snapshot.defences.clear();
+	for (const Defence* defence : m_defences)
+	{
+		DefenceView& view = snapshot.defences.emplace_back();
+		view.position = defence->getPosition();
+		view.type = defence->getType();
+	}
+	snapshot.health = m_health;
+	snapshot.money = m_money;
+	snapshot.fighting = m_fighting;
+	snapshot.over = m_over;
+	snapshot.result = m_result;
+	snapshot.stats = m_stats;
+}
+
+void Simulation::dump(StateDump& dump) const
+{
+	dump.tick = m_tick;
+	dump.random = m_random.getState();
+	dump.health = m_health;
+	dump.money = m_money;
+	dump.leaks = m_leaks;
+	dump.spawn_counter = m_spawn_counter;
+	dump.attack_counter = m_attack_counter;
+	dump.waves_left = static_cast<int>(m_level.size());
+	dump.entities_left = 0;
+	Level level = m_level;
+	dump.next_type = level.empty() ? -1 : level.front().front().index;
+	while (not level.empty())
+	{
+		Wave& wave = level.front();
+		while (not wave.empty())
+		{
+			dump.entities_left += wave.front().count;
+			wave.pop();
+		}
+		level.pop();
+	}
+	dump.spawning = m_spawning;
+	dump.fighting = m_fighting;
+	dump.over = m_over;
+	dump.result = m_result;
+	dump.entities.clear();
+	for (const Entity& entity : m_entities)
+	{
+		EntityDump& entry = dump.entities.emplace_back();
+		entry.type = entity.getType();
+		entry.health = entity.getHealth();
+		entry.freeze = entity.getFreezeCount();
+		entry.position = entity.getPosition();
+	}
+	dump.defences.clear();
+	for (const Defence* defence : m_defences)
+	{
+		DefenceDump& entry = dump.defences.emplace_back();
+		entry.type = defence->getType();
+		entry.counter = defence->getCounter();
+	}
+}
+
+std::uint64_t Simulation::checksum() const
+{
+	std::uint64_t hash = hashValue(HASH_BASIS, m_tick);
+	hash = hashValue(hash, m_random.getState());
+	hash = hashValue(hash, static_cast<std::uint64_t>(m_health) << 32 | static_cast<std::uint32_t>(m_money));
+	hash = hashValue(hash, static_cast<std::uint64_t>(m_leaks) << 32 | static_cast<std::uint32_t>(m_level.size()));
+	hash = hashValue(hash, static_cast<std::uint64_t>(m_spawn_counter) << 32 | static_cast<std::uint32_t>(m_attack_counter));
+	hash = hashValue(hash, m_spawning | m_fighting << 1 | m_over << 2);
+	for (const Entity& entity : m_entities)
+	{
+		FixedVector position = entity.getPosition();
+		hash = hashValue(hash, static_cast<std::uint64_t>(static_cast<std::uint32_t>(position.x)) << 32
+			| static_cast<std::uint32_t>(position.y));
+		hash = hashValue(hash, static_cast<std::uint64_t>(entity.getType()) << 48
+			| static_cast<std::uint64_t>(static_cast<std::uint16_t>(entity.getFreezeCount())) << 32
+			| static_cast<std::uint32_t>(entity.getHealth()));
+	}
+	for (const Defence* defence : m_defences)
+	{
+		FixedVector position = defence->getPosition();
+		hash = hashValue(hash, static_cast<std::uint64_t>(static_cast<std::uint32_t>(position.x)) << 32
+			| static_cast<std::uint32_t>(position.y));
+		hash = hashValue(hash, static_cast<std::uint64_t>(static_cast<int>(defence->getType()) + 1) << 32
+			| static_cast<std::uint32_t>(defence->getCounter()));
+	}
+	return hash;
+}
+
+void Simulation::write(ByteWriter& writer) const
+{
+	// the level cursor is what is left of the level, group by group
+	Level level = m_level;
+	writer.writeVarint(level.size());
+	while (not level.empty())
+	{
+		Wave& wave = level.front();
+		writer.writeVarint(wave.size());
+		while (not wave.empty())
+		{
+			writer.writeVarint(wave.front().index);
+			writer.writeVarint(wave.front().count);
+			wave.pop();
+		}
+		level.pop();
+	}
+	writer.writeByte(static_cast<std::uint8_t>(m_spawning | m_fighting << 1 | m_over << 2));
+	writer.writeByte(static_cast<std::uint8_t>(m_result));
+	writer.writeVarint(m_tick);
+	writer.writeWord(m_random.getState());
+	writer.writeSigned(m_spawn_counter);
+	writer.writeSigned(m_attack_counter);
+	writer.writeSigned(m_health);
+	writer.writeSigned(m_leaks);
+	writer.writeSigned(m_money);
+	writer.writeVarint(m_inserter);
+
+	writer.writeVarint(m_entities.size());
+	for (const Entity& entity : m_entities)
+		entity.write(writer);
+	writer.writeVarint(m_defences.size());
+	for (const Defence* defence : m_defences)
+	{
+		writer.writeByte(static_cast<std::uint8_t>(defence->getType()));
+		defence->write(writer);
+	}
+	// dividers as positions in the list, found in one pass since they are in list order
+	std::uint64_t position = 0;
+	int divider = 0;
+	for (auto it = m_entities.begin(); it != m_entities.end(); ++it, ++position)
+	{
+		for (; divider < m_dividers.size() and m_dividers[divider] == it; ++divider)
+			writer.writeVarint(position);
+	}
+	for (; divider < m_dividers.size(); ++divider)
+		writer.writeVarint(position);
+}
+
+void Simulation::read(ByteReader& reader)
+{
+	Shop& shop_ref = Shop::getInstance();
+	for (Defence* defence : m_defences)
+		shop_ref.recycleDefence(defence);
+	m_defences.clear();
+	m_graveyard.splice(m_graveyard.end(), m_entities);
+
+	m_level = Level();
+	for (std::uint64_t waves = reader.readCount(); waves > 0; --waves)
+	{
+		Wave wave;
+		for (std::uint64_t groups = reader.readCount(); groups > 0; --groups)
+		{
+			int index = static_cast<int>(reader.readVarint());
+			wave.emplace(index, static_cast<int>(reader.readVarint()));
+		}
+		m_level.push(wave);
+	}
+	std::uint8_t flags = reader.readByte();
+	m_spawning = flags & 1;
+	m_fighting = flags & 2;
+	m_over = flags & 4;
+	m_result = static_cast<Result>(reader.readByte());
+	m_tick = reader.readVarint();
+	m_random.setState(reader.readWord());
+	m_spawn_counter = static_cast<int>(reader.readSigned());
+	m_attack_counter = static_cast<int>(reader.readSigned());
+	m_health = static_cast<int>(reader.readSigned());
+	m_leaks = static_cast<int>(reader.readSigned());
+	m_money = static_cast<int>(reader.readSigned());
+	m_inserter = static_cast<int>(reader.readVarint());
+
+	for (std::uint64_t entities = reader.readCount(); entities > 0; --entities)
+	{
+		if (m_graveyard.empty())
+			m_entities.emplace_back(reader);
+		else
+		{
+			m_graveyard.front() = Entity(reader);
+			m_entities.splice(m_entities.end(), m_graveyard, m_graveyard.begin());
+		}
+	}
+	for (std::uint64_t defences = reader.readCount(); defences > 0; --defences)
+	{
+		Defence* defence = nullptr;
+		int type = reader.readByte();
+		if (type < DEFENCES_NUMBER)
+			shop_ref.assignDefence(static_cast<DefenceType>(type), defence);
+		if (defence == nullptr)
+			throw Error(Problem::FileError);
+		m_defences.push_back(defence);
+		defence->read(reader);
+	}
+	if (m_inserter < 1 or m_inserter > std::max<std::size_t>(1, m_defences.size()))
+		throw Error(Problem::FileError);
+
+	m_dividers.assign(m_defences.size() + 1, m_entities.end());
+	auto it = m_entities.begin();
+	std::uint64_t position = 0;
+	for (auto& divider : m_dividers)
+	{
+		std::uint64_t target = reader.readVarint();
+		if (target < position or target > m_entities.size())
+			throw Error(Problem::FileError);
+		for (; position < target; ++position)
+			++it;
+		divider = it;
+	}
+}
+
+const std::list<Entity>& Simulation::getEntities() const
+{
+	return m_entities;
+}
+
+const std::vector<Defence*>& Simulation::getDefences() const
+{
+	return m_defences;
+}
+
+std::uint64_t Simulation::getTick() const
+{
+	return m_tick;
+}
+
+int Simulation::getHealth() const
+{
+	return m_health;
+}
+
+int Simulation::getMoney() const
+{
+	return m_money;
+}
+
+int Simulation::getLeaks() const
+{
+	return m_leaks;
+}
+
+bool Simulation::isFighting() const
+{
+	return m_fighting;
+}
+
+bool Simulation::isOver() const
+{
+	return m_over;
+}
+
+Result Simulation::getResult() const
+{
+	return m_result;
+}
+
+const SimulationStats& Simulation::getStats() const
+{
+	return m_stats;
+}
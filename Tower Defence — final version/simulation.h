@@ -0,0 +1,191 @@
+#pragma once
+#include "arena.h"
+#include "binary.h"
+#include "defence.h"
+#include "entity.h"
+#include "fixed.h"
+#include "manager.h"
+#include "random.h"
+#include "workers.h"
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <SFML/System.hpp>
+
+const int INITIAL_HEALTH = 200, INITIAL_MONEY = 120, SPAWN_PERIOD = 30, ATTACK_PERIOD = 15;
+
+enum class Result { Interrupt, Victory, Failure };
+
+// Player input, handed to the simulation and carried out at the start of its next tick.
+struct Command
+{
+	enum class Kind { Start, Place };
+
+	Kind kind = Kind::Start;
+	DefenceType defence = DefenceType::None;
+	sf::Vector2i position;
+};
+
+struct EntityView
+{
+	FixedVector previous; // where the entity was one tick earlier
+	FixedVector position;
+	int type = 0;
+};
+
+struct DefenceView
+{
+	FixedVector position;
+	DefenceType type = DefenceType::None;
+};
+
+// What the simulation spent and did since it was made; the counts only grow, so the cost
+// of any stretch of ticks is the difference between two readings. The times are taken
+// only when the simulation is timed, as the engine's is for the overlay.
+struct SimulationStats
+{
+	std::uint64_t ticks = 0;
+	std::int64_t spawn_time = 0; // nanoseconds
+	std::int64_t attack_time = 0;
+	std::int64_t move_time = 0;
+	std::uint64_t attack_rounds = 0;
+	std::uint64_t range_tests = 0; // entities tested against a defence's range
+	std::uint64_t hits = 0;
+};
+
+// Immutable picture of one tick, all that is needed to draw it.
+struct Snapshot
+{
+	std::uint64_t tick = 0;
+	std::chrono::steady_clock::time_point stamp; // when the tick ended in real time, set by the publisher
+	std::vector<EntityView> entities;
+	std::vector<DefenceView> defences;
+	int health = 0;
+	int money = 0;
+	bool fighting = false;
+	bool over = false;
+	Result result = Result::Interrupt;
+	SimulationStats stats;
+};
+
+struct EntityDump
+{
+	int type = 0;
+	int health = 0;
+	int freeze = 0;
+	FixedVector position;
+};
+
+struct DefenceDump
+{
+	DefenceType type = DefenceType::None;
+	int counter = 0;
+};
+
+// Every field that decides the rest of a game, in a form that any way of running games
+// can fill, for the determinism checks.
+struct StateDump
+{
+	std::uint64_t tick = 0;
+	std::uint64_t random = 0; // the generator's state
+	int health = 0;
+	int money = 0;
+	int leaks = 0;
+	int spawn_counter = 0;
+	int attack_counter = 0;
+	int waves_left = 0; // the level cursor: what is still to spawn
+	int entities_left = 0;
+	int next_type = -1; // of the entity spawned next
+	bool spawning = false;
+	bool fighting = false;
+	bool over = false;
+	Result result = Result::Interrupt;
+	std::vector<EntityDump> entities;
+	std::vector<DefenceDump> defences;
+};
+
+// State and rules of one game, without any window: the level, entities, defences,
+// money, health and counters. The engine runs one on its own thread; tools may run many.
+class Simulation
+{
+private:
+
+	// level //
+
+	Level m_level;
+	bool m_spawning = false;
+	bool m_fighting = false;
+	int m_spawn_counter = 1;
+
+	// entities //
+
+	std::list<Entity> m_entities;
+	std::list<Entity> m_graveyard; // nodes of dead entities, reused by later spawns
+	int m_health = INITIAL_HEALTH;
+	int m_leaks = 0; // entities that got through
+
+	// defences //
+
+	std::vector<Defence*> m_defences;
+	std::vector<std::list<Entity>::iterator> m_dividers;
+	int m_inserter = 1;
+	int m_attack_counter = ATTACK_PERIOD;
+	int m_money = INITIAL_MONEY;
+
+	// progress //
+
+	std::uint64_t m_tick = 0;
+	bool m_over = false;
+	Result m_result = Result::Interrupt;
+	Random m_random;
+
+	// statistics //
+
+	SimulationStats m_stats; // not part of the game: neither copied, saved nor checked
+	bool m_timed = false;
+
+	// per-tick resources //
+
+	Arena m_scratch;
+	Workers* m_workers = nullptr;
+
+	void startWave();
+	void placeDefence(DefenceType type, const sf::Vector2i& position);
+	void spawnEntity();
+	void doAttacking();
+	void moveEntities();
+	std::list<Entity>::iterator revive(std::list<Entity>::iterator position, int type);
+	std::list<Entity>::iterator bury(std::list<Entity>::iterator it);
+
+public:
+
+	Simulation(const Level& level, Workers* workers = nullptr, std::uint64_t seed = 1);
+	~Simulation();
+	Simulation(const Simulation& other); // an independent game in the same state
+	Simulation& operator=(const Simulation&) = delete;
+
+	void reseed(std::uint64_t seed);
+	void setWorkers(Workers* workers);
+	void setMoney(int money);
+	void setTimed(bool timed); // whether the ticks time their phases
+
+	void execute(const Command& command);
+	void tick();
+	void capture(Snapshot& snapshot) const;
+	void dump(StateDump& dump) const;
+	std::uint64_t checksum() const; // of everything that decides the rest of the game
+	void write(ByteWriter& writer) const; // the whole state, without the workers
+	void read(ByteReader& reader); // replaces the state with one written before; throws on bad data
+
+	const std::list<Entity>& getEntities() const;
+	const std::vector<Defence*>& getDefences() const;
+	std::uint64_t getTick() const;
+	int getHealth() const;
+	int getMoney() const;
+	int getLeaks() const;
+	bool isFighting() const;
+	bool isOver() const;
+	Result getResult() const;
+	const SimulationStats& getStats() const;
+};
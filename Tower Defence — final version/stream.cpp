@@ -0,0 +1,437 @@
+#include "stream.h"
+#include "error.h"
+#include "manager.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+	std::unique_ptr<Broadcaster> s_stream;
+
+	enum FrameFlag : std::uint8_t { FIGHTING = 1, OVER = 2 }; // the result in the bits above
+
+	std::int64_t quantise(Fixed value)
+	{
+		return value >> STREAM_QUANTUM_SHIFT;
+	}
+
+	Fixed restore(std::int64_t value)
+	{
+		return static_cast<Fixed>(value << STREAM_QUANTUM_SHIFT);
+	}
+
+	// prefixes a frame with its length, as a block of its own to share between viewers
+	std::shared_ptr<const std::vector<std::uint8_t>> frame(const ByteWriter& writer)
+	{
+		ByteWriter length;
+		length.writeVarint(writer.getSize());
+		auto bytes = std::make_shared<std::vector<std::uint8_t>>(length.getBytes());
+		bytes->insert(bytes->end(), writer.getBytes().begin(), writer.getBytes().end());
+		return bytes;
+	}
+}
+
+// -- codec -- //
+
+void StreamCodec::writeItem(ByteWriter& writer, const Item& item)
+{
+	writer.writeVarint(item.type);
+	writer.writeSigned(item.health);
+	writer.writeSigned(item.x);
+	writer.writeSigned(item.y);
+}
+
+void StreamCodec::readItem(ByteReader& reader, Item& item)
+{
+	item.type = static_cast<int>(reader.readVarint());
+	item.health = static_cast<int>(reader.readSigned());
+	item.x = reader.readSigned();
+	item.y = reader.readSigned();
+}
+
+bool StreamCodec::encode(const Simulation& simulation, const std::string& map_name, bool full, ByteWriter& writer)
+{
+	const std::vector<Defence*>& defences = simulation.getDefences();
+	// a delta only appends defences, so the ones sent must still lie first and in order;
+	// a rollback of co-op may have placed one among them, or taken one away
+	full = full or map_name != m_map_name or simulation.getTick() < m_tick or defences.size() < m_defences.size();
+	for (std::size_t i = 0; not full and i < m_defences.size(); ++i)
+	{
+		const Item& sent = m_defences[i];
+		full = sent.type != static_cast<int>(defences[i]->getType())
+			or sent.x != quantise(defences[i]->getPosition().x) or sent.y != quantise(defences[i]->getPosition().y);
+	}
+	writer.clear();
+	writer.writeByte(full ? 0 : 1);
+	if (full)
+	{
+		writer.writeString(map_name);
+		writer.writeVarint(simulation.getTick());
+		m_defences.clear();
+	}
+	else
+		writer.writeVarint(simulation.getTick() - m_tick);
+	writer.writeSigned(simulation.getHealth());
+	writer.writeSigned(simulation.getMoney());
+	writer.writeByte(static_cast<std::uint8_t>((simulation.isFighting() ? FIGHTING : 0)
+		| (simulation.isOver() ? OVER : 0) | static_cast<int>(simulation.getResult()) << 2));
+
+	writer.writeVarint(defences.size() - m_defences.size());
+	for (std::size_t i = m_defences.size(); i < defences.size(); ++i)
+	{
+		Item& item = m_defences.emplace_back();
+		item.type = static_cast<int>(defences[i]->getType());
+		item.x = quantise(defences[i]->getPosition().x);
+		item.y = quantise(defences[i]->getPosition().y);
+		writer.writeVarint(item.type);
+		writer.writeSigned(item.x);
+		writer.writeSigned(item.y);
+	}
+
+	// an entity is a move from the first entity of its type nearby among the next few of
+	// the previous frame, those skipped having died; 0 stands for an entity sent in full
+	m_next.clear();
+	const std::list<Entity>& entities = simulation.getEntities();
+	writer.writeVarint(entities.size());
+	std::size_t old = 0;
+	for (const Entity& entity : entities)
+	{
+		Item& item = m_next.emplace_back();
+		item.type = entity.getType();
+		item.health = entity.getHealth();
+		item.x = quantise(entity.getPosition().x);
+		item.y = quantise(entity.getPosition().y);
+		if (full)
+		{
+			writeItem(writer, item);
+			continue;
+		}
+		std::size_t end = std::min(m_entities.size(), old + STREAM_LOOKAHEAD);
+		std::size_t match = old;
+		for (; match < end; ++match)
+		{
+			const Item& before = m_entities[match];
+			if (before.type == item.type and std::abs(item.x - before.x) <= STREAM_MATCH
+				and std::abs(item.y - before.y) <= STREAM_MATCH)
+				break;
+		}
+		if (match == end)
+		{
+			writer.writeVarint(0);
+			writeItem(writer, item);
+		}
+		else
+		{
+			const Item& before = m_entities[match];
+			writer.writeVarint(match - old + 1);
+			writer.writeSigned(item.x - before.x);
+			writer.writeSigned(item.y - before.y);
+			writer.writeSigned(item.health - before.health);
+			old = match + 1;
+		}
+	}
+	m_entities.swap(m_next);
+	m_tick = simulation.getTick();
+	m_map_name = map_name;
+	return full;
+}
+
+void StreamCodec::decode(ByteReader& reader, Snapshot& snapshot)
+{
+	Manager& manager_ref = Manager::getInstance();
+	int kind = reader.readByte();
+	if (kind > 1)
+		throw Error(Problem::FileError);
+	bool full = kind == 0;
+	if (full)
+	{
+		m_map_name = reader.readString();
+		m_tick = reader.readVarint();
+		m_defences.clear();
+		m_entities.clear();
+	}
+	else
+		m_tick += reader.readVarint();
+	snapshot.tick = m_tick;
+	snapshot.health = static_cast<int>(reader.readSigned());
+	snapshot.money = static_cast<int>(reader.readSigned());
+	int flags = reader.readByte();
+	snapshot.fighting = flags & FIGHTING;
+	snapshot.over = flags & OVER;
+	snapshot.result = static_cast<Result>(flags >> 2);
+
+	std::size_t added = reader.readCount();
+	for (std::size_t i = 0; i < added; ++i)
+	{
+		Item& item = m_defences.emplace_back();
+		item.type = static_cast<int>(reader.readVarint());
+		item.x = reader.readSigned();
+		item.y = reader.readSigned();
+		if (item.type < 0 or item.type >= DEFENCES_NUMBER)
+			throw Error(Problem::FileError);
+	}
+	snapshot.defences.clear();
+	for (const Item& item : m_defences)
+	{
+		DefenceView& view = snapshot.defences.emplace_back();
+		view.type = static_cast<DefenceType>(item.type);
+		view.position = FixedVector(restore(item.x), restore(item.y));
+	}
+
+	m_next.clear();
+	snapshot.entities.clear();
+	std::size_t count = reader.readCount();
+	std::size_t old = 0;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		Item& item = m_next.emplace_back();
+		EntityView& view = snapshot.entities.emplace_back();
+		std::uint64_t match = full ? 0 : reader.readVarint();
+		if (match == 0)
+		{
+			readItem(reader, item);
+			view.previous = FixedVector(restore(item.x), restore(item.y));
+		}
+		else
+		{
+			old += match - 1;
+			if (old >= m_entities.size())
+				throw Error(Problem::FileError);
+			const Item& before = m_entities[old++];
+			item.type = before.type;
+			item.x = before.x + reader.readSigned();
+			item.y = before.y + reader.readSigned();
+			item.health = before.health + static_cast<int>(reader.readSigned());
+			view.previous = FixedVector(restore(before.x), restore(before.y));
+		}
+		if (item.type < 0 or item.type >= manager_ref.getEntitiesNumber())
+			throw Error(Problem::FileError);
+		view.position = FixedVector(restore(item.x), restore(item.y));
+		view.type = item.type;
+	}
+	m_entities.swap(m_next);
+}
+
+const std::string& StreamCodec::getMapName() const
+{
+	return m_map_name;
+}
+
+// -- broadcaster -- //
+
+Broadcaster::Broadcaster(unsigned short port)
+{
+	if (m_listener.listen(port) != sf::Socket::Done)
+		throw Error(Problem::NetworkError);
+	m_listener.setBlocking(false);
+	// started once the listener is ready
+	m_thread = std::jthread([this](std::stop_token stop) { work(stop); });
+}
+
+bool Broadcaster::begin()
+{
+	bool following = false;
+	if (not m_following.compare_exchange_strong(following, true))
+		return false;
+	m_since_full = STREAM_FULL_PERIOD;
+	m_last_frame = Clock::time_point();
+	return true;
+}
+
+void Broadcaster::offer(const Simulation& simulation)
+{
+	if (m_watching == 0)
+		return;
+	Clock::time_point now = Clock::now();
+	if (now - m_last_frame < std::chrono::nanoseconds(1000000000LL / STREAM_RATE))
+		return;
+	m_last_frame = now;
+	publish(simulation);
+}
+
+void Broadcaster::end(const Simulation& simulation)
+{
+	if (m_watching > 0)
+		publish(simulation);
+	m_following = false;
+}
+
+void Broadcaster::publish(const Simulation& simulation)
+{
+	bool full = m_full_wanted.exchange(false) or m_since_full >= STREAM_FULL_PERIOD;
+	full = m_codec.encode(simulation, Manager::getInstance().getMapName(), full, m_frame);
+	m_since_full = full ? 1 : m_since_full + 1;
+	Frame outgoing{ full, frame(m_frame) };
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_outbox.push_back(std::move(outgoing));
+	}
+	m_wake.notify_one();
+}
+
+void Broadcaster::accept()
+{
+	while (true)
+	{
+		auto socket = std::make_unique<sf::TcpSocket>();
+		if (m_listener.accept(*socket) != sf::Socket::Done)
+			return;
+		socket->setBlocking(false);
+		ByteWriter greeting;
+		greeting.writeWord(STREAM_MAGIC);
+		greeting.writeVarint(STREAM_VERSION);
+		Viewer& viewer = m_viewers.emplace_back();
+		viewer.socket = std::move(socket);
+		viewer.queue.push_back(frame(greeting));
+		viewer.pending = viewer.queue.back()->size();
+		m_full_wanted = true;
+	}
+}
+
+void Broadcaster::send(Viewer& viewer)
+{
+	while (not viewer.queue.empty())
+	{
+		const std::vector<std::uint8_t>& bytes = *viewer.queue.front();
+		std::size_t sent = 0;
+		sf::Socket::Status status = viewer.socket->send(bytes.data() + viewer.sent, bytes.size() - viewer.sent, sent);
+		viewer.sent += sent;
+		viewer.pending -= sent;
+		if (status == sf::Socket::Done)
+		{
+			viewer.queue.pop_front();
+			viewer.sent = 0;
+		}
+		else if (status == sf::Socket::Partial or status == sf::Socket::NotReady)
+			return;
+		else
+		{
+			viewer.socket.reset();
+			return;
+		}
+	}
+}
+
+void Broadcaster::work(std::stop_token stop)
+{
+	while (not stop.stop_requested())
+	{
+		std::vector<Frame> frames;
+		{
+			// woken by frames, and every few milliseconds to accept viewers and go on sending
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait_for(lock, stop, std::chrono::milliseconds(10), [this]() { return not m_outbox.empty(); });
+			frames.swap(m_outbox);
+		}
+		accept();
+		for (Viewer& viewer : m_viewers)
+		{
+			for (const Frame& frame : frames)
+			{
+				viewer.synced = viewer.synced or frame.full;
+				if (viewer.synced)
+				{
+					viewer.queue.push_back(frame.bytes);
+					viewer.pending += frame.bytes->size();
+				}
+			}
+			if (viewer.pending > STREAM_BACKLOG)
+			{
+				// a frame begun has to be finished, the rest waits for the next full frame
+				while (viewer.queue.size() > (viewer.sent > 0 ? 1 : 0))
+				{
+					viewer.pending -= viewer.queue.back()->size();
+					viewer.queue.pop_back();
+				}
+				viewer.synced = false;
+				m_full_wanted = true;
+			}
+			send(viewer);
+		}
+		std::erase_if(m_viewers, [](const Viewer& viewer) { return viewer.socket == nullptr; });
+		m_watching = static_cast<int>(m_viewers.size());
+	}
+}
+
+void openStream(unsigned short port)
+{
+	s_stream = std::make_unique<Broadcaster>(port);
+}
+
+Broadcaster* getStream()
+{
+	return s_stream.get();
+}
+
+// -- spectator -- //
+
+void Spectator::connect(const std::string& address, unsigned short port)
+{
+	sf::IpAddress remote(address);
+	if (remote == sf::IpAddress::None
+		or m_socket.connect(remote, port, sf::seconds(static_cast<float>(STREAM_TIMEOUT))) != sf::Socket::Done)
+		throw Error(Problem::NetworkError);
+	m_socket.setBlocking(false);
+	m_connected = true;
+}
+
+bool Spectator::receive(Snapshot& snapshot)
+{
+	std::uint8_t chunk[4096];
+	while (m_connected)
+	{
+		std::size_t received = 0;
+		sf::Socket::Status status = m_socket.receive(chunk, sizeof(chunk), received);
+		if (status == sf::Socket::Done)
+			m_buffer.insert(m_buffer.end(), chunk, chunk + received);
+		else if (status == sf::Socket::NotReady or status == sf::Socket::Partial)
+			break;
+		else
+			m_connected = false;
+	}
+
+	// frames that have arrived whole, each after its length; the greeting comes first
+	bool changed = false;
+	std::size_t position = 0;
+	while (true)
+	{
+		std::uint64_t length = 0;
+		std::size_t start = position;
+		bool complete = false;
+		for (int shift = 0; start < m_buffer.size() and shift < 64; shift += 7)
+		{
+			std::uint8_t byte = m_buffer[start++];
+			length |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				complete = true;
+				break;
+			}
+		}
+		if (not complete or m_buffer.size() - start < length)
+			break;
+		ByteReader reader(m_buffer.data() + start, static_cast<std::size_t>(length));
+		if (m_greeted)
+		{
+			m_codec.decode(reader, snapshot);
+			changed = true;
+		}
+		else if (reader.readWord() != STREAM_MAGIC or reader.readVarint() != STREAM_VERSION)
+			throw Error(Problem::NetworkError);
+		else
+			m_greeted = true;
+		position = start + static_cast<std::size_t>(length);
+	}
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + position);
+	return changed;
+}
+
+bool Spectator::isConnected() const
+{
+	return m_connected;
+}
+
+const std::string& Spectator::getMapName() const
+{
+	return m_codec.getMapName();
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "binary.h"
+#include "simulation.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SFML/Network.hpp>
+
+// Spectating: a game is streamed over TCP to any number of viewers, which draw it with
+// the usual renderer. A frame carries the map name, the tick, health, money, defences and
+// every entity's type, health and position in quarter pixels, all as variable-length
+// integers. Every STREAM_FULL_PERIOD-th frame is full; the others are deltas to the frame
+// before them: new defences only, while those sent still lead the list unchanged, and per
+// entity either a small move from an entity of the same type in the previous frame or, when
+// none is near, the full entity. A thousand entities take a few kilobytes a frame.
+// The game thread only encodes frames, at most STREAM_RATE a second and none while nobody
+// watches, and hands them over; a thread of the broadcaster accepts viewers and sends.
+// A viewer that falls behind by more than STREAM_BACKLOG bytes skips to the next full frame.
+// Tools and the game stream with --stream <port>; the game watches with --watch <address>[:<port>].
+
+const std::uint32_t STREAM_MAGIC = 0x53534454; // "TDSS"
+const int STREAM_VERSION = 1;
+const unsigned short STREAM_PORT = 53018;
+const int STREAM_TIMEOUT = 10; // seconds to connect
+const int STREAM_RATE = 60; // frames a second at most
+const int STREAM_FULL_PERIOD = 60; // frames
+const int STREAM_QUANTUM_SHIFT = FIXED_SHIFT - 2; // quarter pixels
+const std::int64_t STREAM_MATCH = 64 << 2; // quanta an entity may move between frames to be sent as a move
+const int STREAM_LOOKAHEAD = 8; // entities of the previous frame searched for a match
+const std::size_t STREAM_BACKLOG = 1 << 20; // bytes
+
+// Frames in the order the entities and defences lie, with the last frame kept to take
+// deltas from. The encoder and the decoder keep the same last frame.
+class StreamCodec
+{
+private:
+
+	struct Item
+	{
+		int type = 0;
+		int health = 0;
+		std::int64_t x = 0; // in quanta
+		std::int64_t y = 0;
+	};
+
+	std::vector<Item> m_entities;
+	std::vector<Item> m_defences;
+	std::vector<Item> m_next; // scratch
+	std::uint64_t m_tick = 0;
+	std::string m_map_name;
+
+	static void writeItem(ByteWriter& writer, const Item& item);
+	static void readItem(ByteReader& reader, Item& item);
+
+public:
+
+	// full frames when asked, and whenever a delta could not describe the change
+	bool encode(const Simulation& simulation, const std::string& map_name, bool full, ByteWriter& writer); // true when full
+	void decode(ByteReader& reader, Snapshot& snapshot); // throws Error(Problem::FileError) on bad data
+	const std::string& getMapName() const;
+};
+
+// Streams the games of this process. Only one game is followed at a time: the first to
+// begin while no other is followed; games of a batch thus follow one another.
+class Broadcaster
+{
+private:
+
+	using Clock = std::chrono::steady_clock;
+	using Bytes = std::shared_ptr<const std::vector<std::uint8_t>>; // a frame with its length in front
+
+	struct Frame
+	{
+		bool full = false;
+		Bytes bytes;
+	};
+
+	struct Viewer
+	{
+		std::unique_ptr<sf::TcpSocket> socket;
+		std::deque<Bytes> queue; // shared with the other viewers
+		std::size_t sent = 0; // bytes of the first frame in the queue
+		std::size_t pending = 0; // bytes in the queue
+		bool synced = false; // has had a full frame, so deltas make sense to it
+	};
+
+	sf::TcpListener m_listener;
+	std::vector<Viewer> m_viewers; // of the broadcasting thread
+
+	// game thread //
+
+	std::atomic<bool> m_following = false;
+	StreamCodec m_codec;
+	ByteWriter m_frame;
+	Clock::time_point m_last_frame;
+	int m_since_full = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable_any m_wake;
+	std::vector<Frame> m_outbox;
+	std::atomic<int> m_watching = 0; // viewers
+	std::atomic<bool> m_full_wanted = false; // a viewer needs one
+	std::jthread m_thread; // last, so that it stops before the rest is destroyed
+
+	void publish(const Simulation& simulation);
+	void work(std::stop_token stop);
+	void accept();
+	void send(Viewer& viewer);
+
+public:
+
+	Broadcaster(unsigned short port); // throws Error(Problem::NetworkError) when it cannot listen
+	Broadcaster(const Broadcaster&) = delete;
+	Broadcaster& operator=(const Broadcaster&) = delete;
+
+	bool begin(); // true when the calling game is the one followed
+	void offer(const Simulation& simulation); // after every tick of the followed game
+	void end(const Simulation& simulation); // sends the last frame
+};
+
+void openStream(unsigned short port); // for the rest of the process
+Broadcaster* getStream(); // nullptr when not streaming
+
+// The receiving end, polled by the viewer.
+class Spectator
+{
+private:
+
+	sf::TcpSocket m_socket;
+	std::vector<std::uint8_t> m_buffer;
+	StreamCodec m_codec;
+	bool m_connected = false;
+	bool m_greeted = false;
+
+public:
+
+	void connect(const std::string& address, unsigned short port); // throws Error(Problem::NetworkError)
+	bool receive(Snapshot& snapshot); // decodes whatever arrived; true when the snapshot changed
+	bool isConnected() const;
+	const std::string& getMapName() const;
+};
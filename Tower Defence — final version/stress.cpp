@@ -0,0 +1,65 @@
+#include "stress.h"
+#include "arguments.h"
+#include "engine.h"
+#include "error.h"
+#include "horde.h"
+#include "manager.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int runStress(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cout << "Usage: stress \"<map name>\" <entities count> [<ticks limit>]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::string map_name = argv[2];
+		int count = parseInt(argv[3]);
+		int ticks_limit = argc > 4 ? parseInt(argv[4]) : 1000000;
+
+		Manager& manager_ref = Manager::getInstance();
+		World::getInstance().setDimensions(WORLD_WIDTH, WORLD_HEIGHT);
+		manager_ref.checkMaps();
+		manager_ref.loadMap(map_name);
+		manager_ref.readEntitiesData();
+
+		int types_number = manager_ref.getEntitiesNumber();
+		Horde horde(types_number);
+		horde.reserve(count);
+		for (int i = 0; i < count; ++i)
+			horde.spawn(i % types_number);
+
+		std::cout << "Map: " << map_name << ", entities: " << count << std::endl
+			<< "Memory: " << horde.footprint() / (1024 * 1024) << " MiB ("
+			<< sizeof(CompactEntity) << " bytes per entity)" << std::endl;
+
+		auto start = std::chrono::steady_clock::now();
+		long long steps = 0, damage = 0;
+		int ticks = 0;
+		while (horde.size() > 0 and ticks < ticks_limit)
+		{
+			steps += horde.size();
+			damage += horde.move();
+			++ticks;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Ticks: " << ticks << ", remaining: " << horde.size()
+			<< ", damage dealt: " << damage << std::endl
+			<< "Time: " << elapsed.count() << " s, "
+			<< steps / std::max(elapsed.count(), 1e-9) / 1e6 << " million entity steps per second" << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Headless stress level: a map is flooded with compact entities, which are moved
+// until they all reach the towers, and the memory and time it took are reported.
+// Usage: stress "<map name>" <entities count> [<ticks limit>]
+
+int runStress(int argc, char* argv[]);
@@ -0,0 +1,332 @@
+#include "sweep.h"
+#include "arguments.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include "random.h"
+#include "workers.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+const std::string SWEEP_OUTPUT = "sweep.csv";
+const std::string SWEEP_LAYOUT = "exits";
+
+namespace
+{
+	struct Parameter
+	{
+		std::string name;
+		int entity = -1; // row of the entity table, or -1 for a defence
+		DefenceType defence = DefenceType::None;
+		std::string column;
+		double low = 0.;
+		double high = 0.;
+	};
+
+	struct Variant
+	{
+		std::vector<double> values;
+		int cost = 0;
+		double win_rate = 0.;
+		double leaks = 0.;
+		double health = 0.;
+		bool pareto = false;
+	};
+
+	bool parseParameter(const std::string& text, Parameter& parameter)
+	{
+		std::size_t dot = text.find('.'), equals = text.find('='), colon = text.find(':');
+		if (dot == std::string::npos or equals == std::string::npos or colon == std::string::npos
+			or not (dot < equals and equals < colon))
+			return false;
+		std::string label = text.substr(0, dot);
+		parameter.name = text.substr(0, equals);
+		parameter.column = text.substr(dot + 1, equals - dot - 1);
+		parameter.low = parseDouble(text.substr(equals + 1, colon - equals - 1));
+		parameter.high = parseDouble(text.substr(colon + 1));
+		for (int i = 0; i < DEFENCES_NUMBER; ++i)
+		{
+			if (LABELS[i] == label)
+				parameter.defence = static_cast<DefenceType>(i);
+		}
+		if (parameter.defence != DefenceType::None)
+		{
+			const std::string columns[]{ "radius", "period", "force", "hits", "cost" };
+			return std::find(std::begin(columns), std::end(columns), parameter.column) != std::end(columns);
+		}
+		if (not Manager::getInstance().hasEntity(label))
+			return false;
+		parameter.entity = Manager::getInstance().getEntityIndex(label);
+		const std::string columns[]{ "speed", "health", "force", "prize" };
+		return std::find(std::begin(columns), std::end(columns), parameter.column) != std::end(columns);
+	}
+
+	void apply(const Parameter& parameter, double value)
+	{
+		Manager& manager_ref = Manager::getInstance();
+		int whole = static_cast<int>(std::lround(value));
+		if (parameter.entity >= 0)
+		{
+			EntityRecord& record = manager_ref.getEntityRecord(parameter.entity);
+			if (parameter.column == "speed")
+				record.speed = std::max(static_cast<float>(value), 1.f / FIXED_ONE);
+			else if (parameter.column == "health")
+				record.health = std::max(whole, 1);
+			else if (parameter.column == "force")
+				record.force = whole;
+			else
+				record.prize = whole;
+		}
+		else
+		{
+			DefenceRecord& record = manager_ref.getDefenceRecord(parameter.defence);
+			if (parameter.column == "radius")
+				record.radius = static_cast<float>(value);
+			else if (parameter.column == "period")
+				record.period = std::max(whole, 1);
+			else if (parameter.column == "force")
+				record.force = whole;
+			else if (parameter.column == "hits")
+				record.hits = whole;
+			else
+				record.cost = std::max(whole, 0);
+		}
+	}
+
+	double current(const Parameter& parameter)
+	{
+		Manager& manager_ref = Manager::getInstance();
+		if (parameter.entity >= 0)
+		{
+			const EntityRecord& record = manager_ref.getEntityRecord(parameter.entity);
+			if (parameter.column == "speed")
+				return record.speed;
+			else if (parameter.column == "health")
+				return record.health;
+			else if (parameter.column == "force")
+				return record.force;
+			else
+				return record.prize;
+		}
+		const DefenceRecord& record = manager_ref.getDefenceRecord(parameter.defence);
+		if (parameter.column == "radius")
+			return record.radius;
+		else if (parameter.column == "period")
+			return record.period;
+		else if (parameter.column == "force")
+			return record.force;
+		else if (parameter.column == "hits")
+			return record.hits;
+		else
+			return record.cost;
+	}
+
+	// the tables are shared by the whole process, so they are put back as they were
+	// however the sweep ends
+	struct Originals
+	{
+		std::vector<Parameter> parameters;
+		std::vector<double> values;
+
+		Originals(const std::vector<Parameter>& swept) :
+			parameters(swept)
+		{
+			for (const Parameter& parameter : parameters)
+				values.push_back(current(parameter));
+		}
+
+		~Originals()
+		{
+			// backwards, so that a column swept twice ends with its first value
+			for (int i = static_cast<int>(parameters.size()) - 1; i >= 0; --i)
+				apply(parameters[i], values[i]);
+		}
+	};
+
+	std::vector<std::vector<double>> gridSamples(const std::vector<Parameter>& parameters, int steps)
+	{
+		std::vector<std::vector<double>> samples;
+		std::vector<int> index(parameters.size(), 0);
+		while (true)
+		{
+			std::vector<double>& sample = samples.emplace_back();
+			for (int i = 0; i < parameters.size(); ++i)
+			{
+				double fraction = steps > 1 ? static_cast<double>(index[i]) / (steps - 1) : 0.;
+				sample.push_back(parameters[i].low + fraction * (parameters[i].high - parameters[i].low));
+			}
+			int i = 0;
+			while (i < index.size() and ++index[i] == steps)
+				index[i++] = 0;
+			if (i == index.size())
+				return samples;
+		}
+	}
+
+	// every parameter range is cut into as many strata as there are samples,
+	// and every stratum of every parameter is used by exactly one sample
+	std::vector<std::vector<double>> hypercubeSamples(const std::vector<Parameter>& parameters, int count)
+	{
+		Random random(static_cast<std::uint64_t>(count) * 104729 + parameters.size());
+		std::vector<std::vector<double>> samples(count, std::vector<double>(parameters.size()));
+		std::vector<int> strata(count);
+		for (int i = 0; i < parameters.size(); ++i)
+		{
+			std::iota(strata.begin(), strata.end(), 0);
+			for (int j = count - 1; j > 0; --j)
+				std::swap(strata[j], strata[random.below(j + 1)]);
+			for (int j = 0; j < count; ++j)
+			{
+				double fraction = (strata[j] + random.next() / 4294967296.) / count;
+				samples[j][i] = parameters[i].low + fraction * (parameters[i].high - parameters[i].low);
+			}
+		}
+		return samples;
+	}
+
+	void markPareto(std::vector<Variant>& variants)
+	{
+		std::vector<Variant*> order;
+		for (Variant& variant : variants)
+			order.push_back(&variant);
+		std::sort(order.begin(), order.end(), [](const Variant* lhs, const Variant* rhs)
+			{
+				return lhs->cost != rhs->cost ? lhs->cost < rhs->cost : lhs->win_rate > rhs->win_rate;
+			});
+		double best = -1.;
+		for (Variant* variant : order)
+		{
+			if (variant->win_rate > best)
+			{
+				variant->pareto = true;
+				best = variant->win_rate;
+			}
+		}
+	}
+}
+
+int runSweep(int argc, char* argv[])
+{
+	if (argc < 8)
+	{
+		std::cout << "Usage: sweep \"<map name>\" \"<level name>\" <seeds> grid <steps> | lhs <samples> "
+			"<label>.<column>=<low>:<high> ... [layout=<none|exits|spread>]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::string map_name = argv[2], level_name = argv[3], mode = argv[5];
+		int seeds = std::max(1, parseInt(argv[4]));
+		int count = std::max(1, parseInt(argv[6]));
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		manager_ref.loadMap(map_name);
+		Level level;
+		manager_ref.loadLevel(level_name, level);
+
+		std::vector<Parameter> parameters;
+		std::string layout_name = SWEEP_LAYOUT;
+		for (int i = 7; i < argc; ++i)
+		{
+			std::string text = argv[i];
+			if (text.rfind("layout=", 0) == 0)
+			{
+				layout_name = text.substr(7);
+				continue;
+			}
+			Parameter& parameter = parameters.emplace_back();
+			if (not parseParameter(text, parameter))
+			{
+				std::cout << "Unknown parameter: " << text << std::endl;
+				return 1;
+			}
+		}
+		if (parameters.empty() or (mode != "grid" and mode != "lhs"))
+		{
+			std::cout << "Nothing to sweep." << std::endl;
+			return 1;
+		}
+
+		// the layout is fixed at the original prices; what it costs changes with the variant
+		Layout layout = referenceLayouts(INITIAL_MONEY)[referenceIndex(layout_name)];
+		std::vector<std::vector<double>> samples = mode == "grid"
+			? gridSamples(parameters, count) : hypercubeSamples(parameters, count);
+
+		Workers workers(std::max(1U, std::thread::hardware_concurrency()) - 1);
+		struct Batch
+		{
+			const Level* level;
+			const Layout* layout;
+			int money;
+			std::vector<Outcome> outcomes;
+		};
+		auto play = [](void* context, int task)
+		{
+			Batch& batch = *static_cast<Batch*>(context);
+			batch.outcomes[task] = playHeadless(*batch.level, *batch.layout, batch.money, task + 1);
+		};
+
+		Originals originals(parameters);
+		std::vector<Variant> variants;
+		for (int i = 0; i < samples.size(); ++i)
+		{
+			for (int j = 0; j < parameters.size(); ++j)
+				apply(parameters[j], samples[i][j]);
+			Variant& variant = variants.emplace_back();
+			variant.values = samples[i];
+			variant.cost = layoutCost(layout);
+			Batch batch{ &level, &layout, variant.cost, std::vector<Outcome>(seeds) };
+			workers.run(seeds, play, &batch);
+			int victories = 0;
+			for (const Outcome& outcome : batch.outcomes)
+			{
+				victories += outcome.result == Result::Victory;
+				variant.leaks += outcome.leaks;
+				variant.health += std::max(0, outcome.health);
+			}
+			variant.win_rate = static_cast<double>(victories) / seeds;
+			variant.leaks /= seeds;
+			variant.health /= seeds;
+			std::cout << "Variant " << i + 1 << " of " << samples.size() << ": cost " << variant.cost
+				<< ", win rate " << variant.win_rate << std::endl;
+		}
+		markPareto(variants);
+
+		std::ofstream output(SWEEP_OUTPUT);
+		for (const Parameter& parameter : parameters)
+			output << parameter.name << ",";
+		output << "cost,win rate,leaks,health,pareto" << std::endl;
+		for (const Variant& variant : variants)
+		{
+			for (double value : variant.values)
+				output << value << ",";
+			output << variant.cost << "," << variant.win_rate << "," << variant.leaks << ","
+				<< variant.health << "," << (variant.pareto ? 1 : 0) << std::endl;
+		}
+		std::cout << std::endl << "Pareto front of cost against win rate (all variants in "
+			<< SWEEP_OUTPUT << "):" << std::endl;
+		for (const Variant& variant : variants)
+		{
+			if (not variant.pareto)
+				continue;
+			std::cout << "\tcost " << variant.cost << ", win rate " << variant.win_rate << ":";
+			for (int j = 0; j < parameters.size(); ++j)
+				std::cout << " " << parameters[j].name << "=" << variant.values[j];
+			std::cout << std::endl;
+		}
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Balance sweep: chosen columns of the entity and defence tables are varied over a grid
+// or a Latin hypercube, the records are patched in memory for every variant, and seeded
+// headless games with a reference layout measure its win rate. All variants go to a CSV
+// file, where those on the Pareto front of layout cost against win rate are marked.
+// Usage: sweep "<map name>" "<level name>" <seeds> grid <steps> | lhs <samples>
+//     <label>.<column>=<low>:<high> ... [layout=<none|exits|spread>]
+// Columns: speed, health, force, prize of entities; radius, period, force, hits, cost of defences.
+
+int runSweep(int argc, char* argv[]);
@@ -0,0 +1,856 @@
+#include "tournament.h"
+#include "arguments.h"
+#include "binary.h"
+#include "bot.h"
+#include "engine.h"
+#include "error.h"
+#include "headless.h"
+#include "workers.h"
+#include "world.h"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+const std::string LEADERBOARD_FILE = "leaderboard.tsv";
+const int BOT_CAPACITY = 256; // placements a bot may return for one match
+const double BOT_START_TIMEOUT = 10.; // seconds for a bot host to load its library and greet
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// the ends of the pipes to and from a bot host, and the host itself
+#if defined(_WIN32)
+	using Pipe = HANDLE;
+	using Process = HANDLE;
+	const Pipe NO_PIPE = INVALID_HANDLE_VALUE;
+	const Process NO_PROCESS = nullptr;
+#else
+	using Pipe = int;
+	using Process = pid_t;
+	const Pipe NO_PIPE = -1;
+	const Process NO_PROCESS = -1;
+#endif
+
+	void* openLibrary(const std::string& path)
+	{
+#if defined(_WIN32)
+		return reinterpret_cast<void*>(LoadLibraryA(path.c_str()));
+#else
+		return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+	}
+
+	void* findSymbol(void* library, const char* name)
+	{
+#if defined(_WIN32)
+		return reinterpret_cast<void*>(GetProcAddress(reinterpret_cast<HMODULE>(library), name));
+#else
+		return dlsym(library, name);
+#endif
+	}
+
+	// CPU time of the calling thread, so that bots deciding in parallel are charged apart
+	double threadSeconds()
+	{
+#if defined(_WIN32)
+		FILETIME creation, exit, kernel, user;
+		GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+		auto ticks = [](const FILETIME& time)
+		{
+			return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		};
+		return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+		timespec time;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+		return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+	}
+
+	bool writeAll(Pipe pipe, const std::uint8_t* data, std::size_t size)
+	{
+		while (size > 0)
+		{
+#if defined(_WIN32)
+			DWORD written = 0;
+			if (not WriteFile(pipe, data, static_cast<DWORD>(size), &written, nullptr))
+				return false;
+#else
+			ssize_t written = write(pipe, data, size);
+			if (written < 0 and errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+#endif
+			data += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	// the bytes read, 0 when the other end is gone, -1 when the deadline passed first
+	long long readSome(Pipe pipe, std::uint8_t* data, std::size_t size, Clock::time_point deadline)
+	{
+#if defined(_WIN32)
+		// anonymous pipes cannot wait with a timeout, so a bounded read peeks until data comes
+		DWORD available = 0;
+		while (deadline != Clock::time_point::max())
+		{
+			if (not PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr))
+				return 0;
+			if (available > 0)
+				break;
+			if (Clock::now() >= deadline)
+				return -1;
+			Sleep(1);
+		}
+		DWORD read = 0;
+		DWORD wanted = static_cast<DWORD>(available > 0 ? std::min<std::size_t>(size, available) : size);
+		if (not ReadFile(pipe, data, wanted, &read, nullptr))
+			return 0;
+		return read;
+#else
+		while (true)
+		{
+			int timeout = -1;
+			if (deadline != Clock::time_point::max())
+			{
+				auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+				timeout = static_cast<int>(std::max<long long>(0, left.count()));
+			}
+			pollfd waited{ pipe, POLLIN, 0 };
+			int ready = poll(&waited, 1, timeout);
+			if (ready < 0 and errno == EINTR)
+				continue;
+			if (ready == 0)
+				return -1;
+			ssize_t read = ready < 0 ? -1 : ::read(pipe, data, size);
+			if (read < 0 and errno == EINTR)
+				continue;
+			return std::max<ssize_t>(read, 0);
+		}
+#endif
+	}
+
+	// a message goes after its length, as the frames of a stream do
+	bool sendMessage(Pipe pipe, const ByteWriter& message)
+	{
+		ByteWriter length;
+		length.writeVarint(message.getSize());
+		return writeAll(pipe, length.getBytes().data(), length.getSize())
+			and writeAll(pipe, message.getBytes().data(), message.getSize());
+	}
+
+	// false when the other end is gone or the deadline passed
+	bool receiveMessage(Pipe pipe, std::vector<std::uint8_t>& message, Clock::time_point deadline)
+	{
+		std::uint64_t length = 0;
+		for (int shift = 0;; shift += 7)
+		{
+			std::uint8_t byte = 0;
+			if (shift >= 64 or readSome(pipe, &byte, 1, deadline) <= 0)
+				return false;
+			length |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		message.resize(static_cast<std::size_t>(length));
+		for (std::size_t received = 0; received < message.size();)
+		{
+			long long read = readSome(pipe, message.data() + received, message.size() - received, deadline);
+			if (read <= 0)
+				return false;
+			received += static_cast<std::size_t>(read);
+		}
+		return true;
+	}
+
+	// runs this program again as a bot host for the library, talking through its standard input and output
+	bool startHost(const std::string& library, Process& process, Pipe& input, Pipe& output)
+	{
+#if defined(_WIN32)
+		SECURITY_ATTRIBUTES attributes{ sizeof(attributes), nullptr, TRUE };
+		HANDLE child_input = nullptr, child_output = nullptr;
+		if (not CreatePipe(&child_input, &input, &attributes, 0))
+			return false;
+		if (not CreatePipe(&output, &child_output, &attributes, 0))
+		{
+			CloseHandle(child_input);
+			CloseHandle(input);
+			return false;
+		}
+		// only the child's ends are inherited
+		SetHandleInformation(input, HANDLE_FLAG_INHERIT, 0);
+		SetHandleInformation(output, HANDLE_FLAG_INHERIT, 0);
+		char path[MAX_PATH];
+		GetModuleFileNameA(nullptr, path, MAX_PATH);
+		std::string command = "\"" + std::string(path) + "\" bot \"" + library + "\"";
+		STARTUPINFOA startup{};
+		startup.cb = sizeof(startup);
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = child_input;
+		startup.hStdOutput = child_output;
+		startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		PROCESS_INFORMATION information{};
+		bool created = CreateProcessA(nullptr, command.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr,
+			&startup, &information);
+		CloseHandle(child_input);
+		CloseHandle(child_output);
+		if (not created)
+		{
+			CloseHandle(input);
+			CloseHandle(output);
+			return false;
+		}
+		CloseHandle(information.hThread);
+		process = information.hProcess;
+		return true;
+#else
+		int to_child[2], from_child[2];
+		if (pipe(to_child) != 0)
+			return false;
+		if (pipe(from_child) != 0)
+		{
+			close(to_child[0]);
+			close(to_child[1]);
+			return false;
+		}
+		for (int end : { to_child[0], to_child[1], from_child[0], from_child[1] })
+			fcntl(end, F_SETFD, FD_CLOEXEC);
+		process = fork();
+		if (process == 0)
+		{
+			dup2(to_child[0], 0);
+			dup2(from_child[1], 1);
+			execl("/proc/self/exe", "bot", "bot", library.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+		close(to_child[0]);
+		close(from_child[1]);
+		input = to_child[1];
+		output = from_child[0];
+		if (process < 0)
+		{
+			close(input);
+			close(output);
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	void stopHost(Process process, Pipe input, Pipe output)
+	{
+#if defined(_WIN32)
+		TerminateProcess(process, 1);
+		WaitForSingleObject(process, INFINITE);
+		CloseHandle(process);
+		CloseHandle(input);
+		CloseHandle(output);
+#else
+		kill(process, SIGKILL);
+		waitpid(process, nullptr, 0);
+		close(input);
+		close(output);
+#endif
+	}
+
+	void writeFloat(ByteWriter& writer, float value)
+	{
+		writer.writeVarint(std::bit_cast<std::uint32_t>(value));
+	}
+
+	float readFloat(ByteReader& reader)
+	{
+		return std::bit_cast<float>(static_cast<std::uint32_t>(reader.readVarint()));
+	}
+
+	// what a bot is told about the loaded map, the level and the rules
+	struct Description
+	{
+		std::vector<BotPoint> points;
+		std::vector<BotEdge> edges;
+		std::vector<BotDefence> defences;
+		std::vector<BotEntity> entities;
+		std::vector<BotGroup> groups;
+		std::vector<int> wave_ends;
+		BotGame game{};
+	};
+
+	// points the game at the arrays of the description
+	void link(Description& description)
+	{
+		BotGame& game = description.game;
+		game.points = description.points.data();
+		game.points_number = static_cast<int>(description.points.size());
+		game.edges = description.edges.data();
+		game.edges_number = static_cast<int>(description.edges.size());
+		game.defences = description.defences.data();
+		game.defences_number = static_cast<int>(description.defences.size());
+		game.entities = description.entities.data();
+		game.entities_number = static_cast<int>(description.entities.size());
+		game.groups = description.groups.data();
+		game.groups_number = static_cast<int>(description.groups.size());
+		game.wave_ends = description.wave_ends.data();
+		game.waves_number = static_cast<int>(description.wave_ends.size());
+	}
+
+	void describeMap(Description& description)
+	{
+		World& world_ref = World::getInstance();
+		Manager& manager_ref = Manager::getInstance();
+		description.points.clear();
+		for (int i = 0; i < world_ref.getPointsNumber(); ++i)
+		{
+			sf::Vector2f coords = toFloat(world_ref.getCoords(i));
+			PointType type = world_ref.getType(i);
+			int kind = type == PointType::Source ? BOT_SOURCE : type == PointType::Tower ? BOT_TOWER : BOT_VERTEX;
+			description.points.push_back({ coords.x, coords.y, kind });
+		}
+		description.edges.clear();
+		for (int i = 0; i < world_ref.getEdgesNumber(); ++i)
+		{
+			const Edge& edge = world_ref.getEdge(i);
+			description.edges.push_back({ edge.tail, edge.head });
+		}
+		description.defences.clear();
+		for (int type = 0; type < DEFENCES_NUMBER; ++type)
+		{
+			const DefenceRecord& record = manager_ref.getDefenceRecord(static_cast<DefenceType>(type));
+			description.defences.push_back({ record.cost, record.radius, record.period, record.force, record.hits });
+		}
+		description.entities.clear();
+		for (int type = 0; type < manager_ref.getEntitiesNumber(); ++type)
+		{
+			const EntityRecord& record = manager_ref.getEntityRecord(type);
+			description.entities.push_back({ record.speed, record.health, record.force, record.prize });
+		}
+	}
+
+	void describeLevel(const Level& level, int money, Description& description)
+	{
+		description.groups.clear();
+		description.wave_ends.clear();
+		Level copy = level;
+		while (not copy.empty())
+		{
+			Wave& wave = copy.front();
+			while (not wave.empty())
+			{
+				description.groups.push_back({ wave.front().index, wave.front().count });
+				wave.pop();
+			}
+			description.wave_ends.push_back(static_cast<int>(description.groups.size()));
+			copy.pop();
+		}
+
+		sf::Vector2f dimensions = World::getInstance().getDimensions();
+		description.game.width = dimensions.x;
+		description.game.height = dimensions.y;
+		description.game.money = money;
+		link(description);
+	}
+
+	// what a bot host is sent for a match; the map is sent again with every level, as it is small
+	void writeGame(ByteWriter& writer, const Description& description)
+	{
+		writeFloat(writer, description.game.width);
+		writeFloat(writer, description.game.height);
+		writer.writeSigned(description.game.money);
+		writer.writeVarint(description.points.size());
+		for (const BotPoint& point : description.points)
+		{
+			writeFloat(writer, point.x);
+			writeFloat(writer, point.y);
+			writer.writeVarint(point.kind);
+		}
+		writer.writeVarint(description.edges.size());
+		for (const BotEdge& edge : description.edges)
+		{
+			writer.writeVarint(edge.tail);
+			writer.writeVarint(edge.head);
+		}
+		writer.writeVarint(description.defences.size());
+		for (const BotDefence& defence : description.defences)
+		{
+			writer.writeSigned(defence.cost);
+			writeFloat(writer, defence.radius);
+			writer.writeSigned(defence.period);
+			writer.writeSigned(defence.force);
+			writer.writeSigned(defence.hits);
+		}
+		writer.writeVarint(description.entities.size());
+		for (const BotEntity& entity : description.entities)
+		{
+			writeFloat(writer, entity.speed);
+			writer.writeSigned(entity.health);
+			writer.writeSigned(entity.force);
+			writer.writeSigned(entity.prize);
+		}
+		writer.writeVarint(description.groups.size());
+		for (const BotGroup& group : description.groups)
+		{
+			writer.writeVarint(group.entity);
+			writer.writeVarint(group.count);
+		}
+		writer.writeVarint(description.wave_ends.size());
+		for (int end : description.wave_ends)
+			writer.writeVarint(end);
+	}
+
+	void readGame(ByteReader& reader, Description& description)
+	{
+		description.game.width = readFloat(reader);
+		description.game.height = readFloat(reader);
+		description.game.money = static_cast<int>(reader.readSigned());
+		description.points.resize(reader.readCount());
+		for (BotPoint& point : description.points)
+		{
+			point.x = readFloat(reader);
+			point.y = readFloat(reader);
+			point.kind = static_cast<int>(reader.readVarint());
+		}
+		description.edges.resize(reader.readCount());
+		for (BotEdge& edge : description.edges)
+		{
+			edge.tail = static_cast<int>(reader.readVarint());
+			edge.head = static_cast<int>(reader.readVarint());
+		}
+		description.defences.resize(reader.readCount());
+		for (BotDefence& defence : description.defences)
+		{
+			defence.cost = static_cast<int>(reader.readSigned());
+			defence.radius = readFloat(reader);
+			defence.period = static_cast<int>(reader.readSigned());
+			defence.force = static_cast<int>(reader.readSigned());
+			defence.hits = static_cast<int>(reader.readSigned());
+		}
+		description.entities.resize(reader.readCount());
+		for (BotEntity& entity : description.entities)
+		{
+			entity.speed = readFloat(reader);
+			entity.health = static_cast<int>(reader.readSigned());
+			entity.force = static_cast<int>(reader.readSigned());
+			entity.prize = static_cast<int>(reader.readSigned());
+		}
+		description.groups.resize(reader.readCount());
+		for (BotGroup& group : description.groups)
+		{
+			group.entity = static_cast<int>(reader.readVarint());
+			group.count = static_cast<int>(reader.readVarint());
+		}
+		description.wave_ends.resize(reader.readCount());
+		for (int& end : description.wave_ends)
+			end = static_cast<int>(reader.readVarint());
+		link(description);
+	}
+
+	// a bot host seen from the tournament: a child process, so that a bot that hangs or crashes
+	// takes only itself down; one that has not answered by the deadline is killed at once
+	class Bot
+	{
+	private:
+
+		Process m_process = NO_PROCESS;
+		Pipe m_input = NO_PIPE; // the host's standard input
+		Pipe m_output = NO_PIPE;
+		std::string m_path;
+		std::string m_name;
+
+		void stop()
+		{
+			if (m_process != NO_PROCESS)
+				stopHost(m_process, m_input, m_output);
+			m_process = NO_PROCESS;
+			m_input = m_output = NO_PIPE;
+		}
+
+	public:
+
+		Bot() = default;
+		Bot(const Bot&) = delete;
+		Bot& operator=(const Bot&) = delete;
+		~Bot()
+		{
+			stop();
+		}
+
+		// on failure the reason is returned and the bot is left stopped
+		std::string load(const std::string& path)
+		{
+			m_path = path;
+			if (not startHost(path, m_process, m_input, m_output))
+			{
+				m_process = NO_PROCESS;
+				return "cannot be started";
+			}
+			std::vector<std::uint8_t> greeting;
+			Clock::time_point deadline = Clock::now()
+				+ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(BOT_START_TIMEOUT));
+			std::string problem = "does not answer";
+			if (receiveMessage(m_output, greeting, deadline))
+			{
+				try
+				{
+					ByteReader reader(greeting);
+					problem = reader.readString();
+					std::string name = reader.readString();
+					m_name = not name.empty() ? name : path;
+				}
+				catch (Error)
+				{
+					problem = "does not answer";
+				}
+			}
+			if (not problem.empty())
+				stop();
+			return problem;
+		}
+
+		// after a forfeit that cost the bot its host; false when it could not be brought back
+		bool restart()
+		{
+			return isRunning() or load(m_path).empty();
+		}
+
+		bool isRunning() const
+		{
+			return m_process != NO_PROCESS;
+		}
+
+		const std::string& getName() const
+		{
+			return m_name;
+		}
+
+		// false when the bot forfeits: it had no host, did not answer within the budget or sent
+		// nonsense, and is stopped, or it spent more CPU time than the budget
+		bool place(const Description& description, double budget, std::vector<BotPlacement>& placements,
+			double& seconds)
+		{
+			placements.clear();
+			seconds = budget;
+			if (not isRunning())
+				return false;
+			ByteWriter request;
+			writeGame(request, description);
+			std::vector<std::uint8_t> answer;
+			Clock::time_point deadline = Clock::now()
+				+ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(budget));
+			if (not sendMessage(m_input, request) or not receiveMessage(m_output, answer, deadline))
+			{
+				stop();
+				return false;
+			}
+			try
+			{
+				ByteReader reader(answer);
+				placements.resize(std::min<std::uint64_t>(reader.readCount(), BOT_CAPACITY));
+				for (BotPlacement& placement : placements)
+				{
+					placement.type = static_cast<int>(reader.readSigned());
+					placement.x = static_cast<int>(reader.readSigned());
+					placement.y = static_cast<int>(reader.readSigned());
+				}
+				seconds = std::bit_cast<double>(reader.readWord());
+			}
+			catch (Error)
+			{
+				placements.clear();
+				seconds = budget;
+				stop();
+				return false;
+			}
+			return seconds <= budget;
+		}
+	};
+
+	struct Standing
+	{
+		std::string name;
+		int games = 0;
+		int victories = 0;
+		long long health = 0; // left at the end, summed over games
+		long long leaks = 0;
+		int matches = 0;
+		int forfeits = 0;
+		double seconds = 0.; // CPU time spent deciding
+	};
+
+	// one map and level: every bot decides, then plays its layout over the seeds
+	struct Match
+	{
+		const Level* level;
+		const Description* description;
+		const std::vector<std::unique_ptr<Bot>>* bots;
+		double budget; // seconds
+		int seeds;
+		std::vector<Layout> layouts;
+		std::vector<double> seconds;
+		std::vector<std::uint8_t> forfeits;
+		std::vector<Outcome> outcomes;
+	};
+
+	void decide(void* context, int task)
+	{
+		Match& match = *static_cast<Match*>(context);
+		const BotGame& game = match.description->game;
+		std::vector<BotPlacement> placements;
+		bool fair = (*match.bots)[task]->place(*match.description, match.budget, placements, match.seconds[task]);
+
+		Layout& layout = match.layouts[task];
+		layout.clear();
+		match.forfeits[task] = not fair;
+		if (match.forfeits[task])
+			return;
+		for (const BotPlacement& placement : placements)
+		{
+			if (placement.type < 0 or placement.type >= DEFENCES_NUMBER or placement.x < 0 or placement.y < 0
+				or placement.x >= game.width or placement.y >= game.height)
+				continue;
+			layout.push_back({ static_cast<DefenceType>(placement.type), { placement.x, placement.y } });
+		}
+	}
+
+	void play(void* context, int task)
+	{
+		Match& match = *static_cast<Match*>(context);
+		match.outcomes[task] = playHeadless(*match.level, match.layouts[task / match.seeds], INITIAL_MONEY,
+			task % match.seeds + 1);
+	}
+
+	void writeLeaderboard(const std::string& path, const std::vector<Standing>& standings)
+	{
+		std::ofstream file(path);
+		if (not file.is_open())
+			throw Error(Problem::FileError);
+		file << "rank\tbot\tvictories\tgames\twin rate\thealth per game\tleaks per game\tforfeits\tCPU seconds"
+			<< std::endl;
+		for (int i = 0; i < standings.size(); ++i)
+		{
+			const Standing& standing = standings[i];
+			double games = std::max(1, standing.games);
+			file << i + 1 << '\t' << standing.name << '\t' << standing.victories << '\t' << standing.games << '\t'
+				<< standing.victories / games << '\t' << standing.health / games << '\t' << standing.leaks / games
+				<< '\t' << standing.forfeits << '\t' << standing.seconds << std::endl;
+		}
+	}
+}
+
+int runTournament(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		std::cout << "Usage: tournament <seeds> <budget in ms> <bot library> [<bot library> ...]" << std::endl;
+		return 1;
+	}
+	try
+	{
+		int seeds = std::max(1, parseInt(argv[2]));
+		double budget = std::max(0, parseInt(argv[3])) / 1000.;
+#if !defined(_WIN32)
+		// a host that died is found out by reading from it, not by a signal when writing to it
+		signal(SIGPIPE, SIG_IGN);
+#endif
+
+		std::vector<std::unique_ptr<Bot>> bots;
+		for (int i = 4; i < argc; ++i)
+		{
+			auto bot = std::make_unique<Bot>();
+			std::string problem = bot->load(argv[i]);
+			if (problem.empty())
+				bots.push_back(std::move(bot));
+			else
+				std::cout << "Bot " << argv[i] << " " << problem << ", skipped." << std::endl;
+		}
+		if (bots.empty())
+		{
+			std::cout << "No bot to play." << std::endl;
+			return 1;
+		}
+		int bots_number = static_cast<int>(bots.size());
+
+		loadHeadless();
+		Manager& manager_ref = Manager::getInstance();
+		std::vector<std::string> map_names = manager_ref.getMapNames();
+		std::vector<std::string> level_names = manager_ref.getLevelNames();
+		std::vector<Level> levels(level_names.size());
+		for (int i = 0; i < level_names.size(); ++i)
+			manager_ref.loadLevel(level_names[i], levels[i]);
+
+		std::vector<Standing> standings(bots_number);
+		for (int i = 0; i < bots_number; ++i)
+			standings[i].name = bots[i]->getName();
+		Workers workers(std::max(1U, std::thread::hardware_concurrency()) - 1);
+		Description description;
+		Match match{ nullptr, &description, &bots, budget, seeds,
+			std::vector<Layout>(bots_number), std::vector<double>(bots_number),
+			std::vector<std::uint8_t>(bots_number), std::vector<Outcome>(bots_number * seeds) };
+
+		auto start = std::chrono::steady_clock::now();
+		for (const std::string& map_name : map_names)
+		{
+			manager_ref.loadMap(map_name);
+			describeMap(description);
+			for (int i = 0; i < level_names.size(); ++i)
+			{
+				match.level = &levels[i];
+				describeLevel(levels[i], INITIAL_MONEY, description);
+				workers.run(bots_number, decide, &match);
+				workers.run(bots_number * seeds, play, &match);
+				// one at a time, so that no host inherits the pipes of another
+				for (const std::unique_ptr<Bot>& bot : bots)
+					bot->restart();
+				for (int bot = 0; bot < bots_number; ++bot)
+				{
+					Standing& standing = standings[bot];
+					++standing.matches;
+					standing.forfeits += match.forfeits[bot];
+					standing.seconds += match.seconds[bot];
+					for (int seed = 0; seed < seeds; ++seed)
+					{
+						const Outcome& outcome = match.outcomes[bot * seeds + seed];
+						++standing.games;
+						standing.victories += outcome.result == Result::Victory;
+						standing.health += std::max(0, outcome.health);
+						standing.leaks += outcome.leaks;
+					}
+				}
+				std::cout << map_name << " / " << level_names[i] << " done" << std::endl;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::stable_sort(standings.begin(), standings.end(), [](const Standing& lhs, const Standing& rhs)
+			{
+				if (lhs.victories != rhs.victories)
+					return lhs.victories > rhs.victories;
+				if (lhs.health != rhs.health)
+					return lhs.health > rhs.health;
+				return lhs.leaks < rhs.leaks;
+			});
+		writeLeaderboard(LEADERBOARD_FILE, standings);
+
+		std::cout << std::endl;
+		for (int i = 0; i < standings.size(); ++i)
+		{
+			const Standing& standing = standings[i];
+			std::ostringstream health;
+			health << std::fixed << std::setprecision(1)
+				<< static_cast<double>(standing.health) / std::max(1, standing.games);
+			std::cout << std::setw(3) << i + 1 << ". " << std::left << std::setw(24) << standing.name << std::right
+				<< std::setw(6) << standing.victories << " / " << standing.games << " won, " << health.str()
+				<< " health per game, " << standing.forfeits << " of " << standing.matches << " matches forfeited"
+				<< std::endl;
+		}
+		std::cout << std::endl << "Leaderboard written to " << LEADERBOARD_FILE << ", time: " << elapsed.count()
+			<< " s on " << std::max(1U, std::thread::hardware_concurrency()) << " threads" << std::endl;
+	}
+	catch (Error err)
+	{
+		std::cout << "An error has been encountered:" << std::endl << std::endl
+			<< "\t" << err.what() << std::endl << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int runBotHost(int argc, char* argv[])
+{
+	if (argc < 3)
+		return 1;
+	// the requests come by the standard input and the answers leave by the standard output,
+	// which is kept for them alone: whatever the bot prints goes to the standard error
+#if defined(_WIN32)
+	Pipe input = GetStdHandle(STD_INPUT_HANDLE), output = NO_PIPE;
+	if (not DuplicateHandle(GetCurrentProcess(), GetStdHandle(STD_OUTPUT_HANDLE), GetCurrentProcess(), &output,
+		0, FALSE, DUPLICATE_SAME_ACCESS))
+		return 1;
+	SetStdHandle(STD_OUTPUT_HANDLE, GetStdHandle(STD_ERROR_HANDLE));
+	_dup2(_fileno(stderr), _fileno(stdout));
+#else
+	Pipe input = 0, output = dup(1);
+	dup2(2, 1);
+#endif
+
+	std::string path = argv[2], problem, name;
+	BotPlaceFunction place = nullptr;
+	void* library = openLibrary(path);
+	if (library == nullptr)
+		problem = "cannot be loaded";
+	else
+	{
+		auto version = reinterpret_cast<BotVersionFunction>(findSymbol(library, "botVersion"));
+		auto bot_name = reinterpret_cast<BotNameFunction>(findSymbol(library, "botName"));
+		place = reinterpret_cast<BotPlaceFunction>(findSymbol(library, "botPlace"));
+		if (version == nullptr or bot_name == nullptr or place == nullptr)
+			problem = "does not export botVersion, botName and botPlace";
+		else if (version() != BOT_VERSION)
+			problem = "was built for interface version " + std::to_string(version());
+		else if (bot_name() != nullptr)
+			name = bot_name();
+	}
+	ByteWriter message;
+	message.writeString(problem);
+	message.writeString(name);
+	if (not sendMessage(output, message) or not problem.empty())
+		return 1;
+
+	// a match at a time, until the tournament closes the pipe or kills the host
+	Description description;
+	std::vector<std::uint8_t> request;
+	BotPlacement placements[BOT_CAPACITY];
+	while (receiveMessage(input, request, Clock::time_point::max()))
+	{
+		try
+		{
+			ByteReader reader(request);
+			readGame(reader, description);
+		}
+		catch (Error)
+		{
+			return 1;
+		}
+		double start = threadSeconds();
+		int count = std::clamp(place(&description.game, placements, BOT_CAPACITY), 0, BOT_CAPACITY);
+		double seconds = threadSeconds() - start;
+		message.clear();
+		message.writeVarint(count);
+		for (int i = 0; i < count; ++i)
+		{
+			message.writeSigned(placements[i].type);
+			message.writeSigned(placements[i].x);
+			message.writeSigned(placements[i].y);
+		}
+		message.writeWord(std::bit_cast<std::uint64_t>(seconds));
+		if (not sendMessage(output, message))
+			return 1;
+	}
+	return 0;
+}
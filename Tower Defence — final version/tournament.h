@@ -0,0 +1,13 @@
+#pragma once
+
+// Tournament of placement bots (see bot.h): every bot plays every valid map and level,
+// each match over the same seeded headless games, on all cores. Every bot runs in a bot
+// host of its own, a child process of this program asked for its layouts through a pipe.
+// A bot that has not answered within the budget is killed, and one that crashes dies
+// alone; either forfeits the match and plays it without defences, as does a bot that
+// answered in time but spent more CPU time than the budget. A killed bot is started again
+// for the next match. The standings are written to the leaderboard file.
+// Usage: tournament <seeds> <budget in ms> <bot library> [<bot library> ...]
+
+int runTournament(int argc, char* argv[]);
+int runBotHost(int argc, char* argv[]); // bot <bot library>, started by the tournament
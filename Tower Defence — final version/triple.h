@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+
+// Lock-free triple buffer passing the latest value from one writer to one reader.
+// The writer fills back() and publishes it; the reader calls update() and then
+// reads front(). Neither side ever waits for the other, and a value is only
+// skipped when a newer one has already been published.
+
+template <typename T>
+class TripleBuffer
+{
+private:
+
+	static const unsigned int INDEX_MASK = 0x3U;
+	static const unsigned int FRESH = 0x4U;
+
+	T m_buffers[3];
+	std::atomic<unsigned int> m_middle = 0U; // index of the spare buffer and the FRESH flag
+	unsigned int m_back = 1U; // owned by the writer
+	unsigned int m_front = 2U; // owned by the reader
+
+public:
+
+	T& back()
+	{
+		return m_buffers[m_back];
+	}
+
+	void publish()
+	{
+		m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	bool update()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0U)
+			return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& front() const
+	{
+		return m_buffers[m_front];
+	}
+};
@@ -0,0 +1,82 @@
+#include "workers.h"
+#include "profile.h"
+
+int Workers::drain(Job job, void* context, int tasks)
+{
+	int done = 0;
+	for (int task = m_next++; task < tasks; task = m_next++)
+	{
+		job(context, task);
+		++done;
+	}
+	return done;
+}
+
+void Workers::work()
+{
+	PROFILE_THREAD("worker");
+	unsigned long long seen = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_wake.wait(lock, [this, seen]() { return m_stopping or m_generation != seen; });
+		if (m_stopping)
+			return;
+		seen = m_generation;
+		Job job = m_job;
+		void* context = m_context;
+		int tasks = m_tasks;
+		++m_busy;
+		lock.unlock();
+		int done = drain(job, context, tasks);
+		lock.lock();
+		m_finished += done;
+		--m_busy;
+		m_done.notify_all();
+	}
+}
+
+Workers::Workers(int count)
+{
+	for (int i = 0; i < count; ++i)
+		m_threads.emplace_back(&Workers::work, this);
+}
+
+Workers::~Workers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+void Workers::run(int tasks, Job job, void* context)
+{
+	if (tasks <= 0)
+		return;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		// a late riser of the previous run must not pick up tasks of this one
+		m_done.wait(lock, [this]() { return m_busy == 0; });
+		m_job = job;
+		m_context = context;
+		m_tasks = tasks;
+		m_next = 0;
+		m_finished = 0;
+		++m_generation;
+	}
+	if (not m_threads.empty())
+		m_wake.notify_all();
+	int done = drain(job, context, tasks);
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished += done;
+	m_done.wait(lock, [this]() { return m_finished == m_tasks and m_busy == 0; });
+}
+
+int Workers::getThreadsNumber() const
+{
+	return static_cast<int>(m_threads.size()) + 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent crew of threads sharing the tasks of one run() call with the caller.
+// Nothing is allocated per run, unlike spawning a std::thread for every task.
+
+class Workers
+{
+public:
+
+	using Job = void (*)(void* context, int task);
+
+private:
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	Job m_job = nullptr;
+	void* m_context = nullptr;
+	int m_tasks = 0;
+	std::atomic<int> m_next = 0;
+	int m_finished = 0;
+	int m_busy = 0;
+	unsigned long long m_generation = 0;
+	bool m_stopping = false;
+
+	int drain(Job job, void* context, int tasks);
+	void work();
+
+public:
+
+	Workers(int count);
+	~Workers();
+	Workers(const Workers&) = delete;
+	Workers& operator=(const Workers&) = delete;
+
+	void run(int tasks, Job job, void* context);
+	int getThreadsNumber() const; // the caller's included
+};
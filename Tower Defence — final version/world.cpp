@@ -2,6 +2,19 @@
 #include "error.h"
 #include "graph.h"
 #include "point.h"
+#include "profile.h"
+#include <algorithm>
+
+FixedVector Edge::step(Fixed speed) const
+{
+    return FixedVector(static_cast<Fixed>(difference.x * std::int64_t(speed) / length),
+        static_cast<Fixed>(difference.y * std::int64_t(speed) / length));
+}
+
+int Edge::stepsCount(Fixed speed) const
+{
+    return std::max(1, static_cast<int>(length / speed));
+}
 
 void World::setDimensions(float width, float height)
 {
@@ -16,7 +29,20 @@ sf::Vector2f World::getDimensions() const
 
 void World::loadMap(Graph& graph)
 {
+    // an edge of no length cannot be walked, and steps along it would divide by zero
+    for (const auto& point : graph.body)
+    {
+        for (int neighbour : point.neighbours)
+        {
+            sf::Vector2f tail(point.position.x * m_dimensions.x, point.position.y * m_dimensions.y);
+            sf::Vector2f head(graph.body[neighbour].position.x * m_dimensions.x,
+                graph.body[neighbour].position.y * m_dimensions.y);
+            if (toFixed(tail) == toFixed(head))
+                throw Error(Problem::FileError);
+        }
+    }
     m_sources_number = graph.sources_count;
+    m_points.clear();
     for (auto it = graph.body.begin(); it != graph.body.end(); ++it)
     {
         it->position.x *= m_dimensions.x;
@@ -31,28 +57,49 @@ void World::loadMap(Graph& graph)
             m_points[i].addNeighbour(k, m_points[k].getPosition());
         }
     }
+    m_edges.clear();
+    m_first_edges.clear();
+    for (int i = 0; i < graph.body.size(); ++i)
+    {
+        m_first_edges.push_back(static_cast<int>(m_edges.size()));
+        for (int j = 0; j < graph.body[i].neighbours.size(); ++j)
+        {
+            Edge edge;
+            edge.tail = i;
+            edge.head = graph.body[i].neighbours[j];
+            edge.origin = m_points[i].getCoords();
+            edge.difference = m_points[edge.head].getCoords() - edge.origin;
+            edge.length = squareRoot(squaredLength(edge.difference));
+            edge.terminal = m_points[edge.head].getType() == PointType::Tower;
+            m_edges.push_back(edge);
+        }
+    }
+    m_first_edges.push_back(static_cast<int>(m_edges.size()));
 }
 
-void World::drawEverything(sf::RenderWindow& window)
+int World::drawEverything(sf::RenderWindow& window)
 {
+    PROFILE_ZONE("World::drawEverything");
+    int draws = 0;
     for (auto it = m_points.begin(); it != m_points.end(); ++it)
-        it->drawLines(window);
+        draws += it->drawLines(window);
     for (auto it = m_points.begin(); it != m_points.end(); ++it)
-        it->drawCircle(window);
+        draws += it->drawCircle(window);
+    return draws;
 }
 
-int World::getRandomSource()
+int World::getRandomSource(Random& random)
 {
     if (m_sources_number)
-        return rand() % m_sources_number;
+        return random.below(m_sources_number);
     throw Error(Problem::OutOfRange);
 }
 
-int World::getRandomNeighbour(int index)
+FixedVector World::getCoords(int index)
 {
     try
     {
-        return m_points.at(index).randomNeighbour();
+        return m_points.at(index).getCoords();
     }
     catch (...)
     {
@@ -60,11 +107,21 @@ int World::getRandomNeighbour(int index)
     }
 }
 
-sf::Vector2f World::getCoords(int index)
+int World::getPointsNumber() const
+{
+    return static_cast<int>(m_points.size());
+}
+
+int World::getEdgesNumber() const
+{
+    return static_cast<int>(m_edges.size());
+}
+
+const Edge& World::getEdge(int index) const
 {
     try
     {
-        return m_points.at(index).getPosition();
+        return m_edges.at(index);
     }
     catch (...)
     {
@@ -72,6 +129,16 @@ sf::Vector2f World::getCoords(int index)
     }
 }
 
+int World::getRandomEdge(int index, Random& random)
+{
+    if (index < 0 or index + 1 >= m_first_edges.size())
+        throw Error(Problem::OutOfRange);
+    int count = m_first_edges[index + 1] - m_first_edges[index];
+    if (count == 0)
+        throw Error(Problem::OutOfRange);
+    return m_first_edges[index] + random.below(count);
+}
+
 PointType World::getType(int index)
 {
     try
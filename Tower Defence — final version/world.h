@@ -1,12 +1,28 @@
 #pragma once
 #include "point.h"
 #include "graph.h"
+#include "fixed.h"
+#include "random.h"
+#include <vector>
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #include <SFML/Network.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
+struct Edge
+{
+	int tail = 0;
+	int head = 0;
+	FixedVector origin;
+	FixedVector difference;
+	std::int64_t length = 0;
+	bool terminal = false; // leads to a tower
+
+	FixedVector step(Fixed speed) const;
+	int stepsCount(Fixed speed) const;
+};
+
 class World
 {
 private:
@@ -14,6 +30,11 @@ private:
 	sf::Vector2f m_dimensions;
 	std::vector<Point> m_points;
 	int m_sources_number = 0;
+
+	// outgoing edges of point i are m_edges[m_first_edges[i]] ... m_edges[m_first_edges[i + 1] - 1],
+	// in the order of the point's neighbours
+	std::vector<Edge> m_edges;
+	std::vector<int> m_first_edges;
 	
 	World() = default;
 
@@ -30,11 +51,15 @@ public:
 
 	void loadMap(Graph& graph);
 
-	void drawEverything(sf::RenderWindow& window);
+	int drawEverything(sf::RenderWindow& window); // returns the number of draw calls
 
-	int getRandomSource();
-	int getRandomNeighbour(int index);
+	int getRandomSource(Random& random);
 	PointType getType(int index);
-	sf::Vector2f getCoords(int index);
+	FixedVector getCoords(int index);
+
+	int getPointsNumber() const;
+	int getEdgesNumber() const;
+	const Edge& getEdge(int index) const;
+	int getRandomEdge(int index, Random& random);
 };
 